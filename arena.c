@@ -0,0 +1,202 @@
+/*
+ * @file arena.c
+ * @brief The bump allocator used to hold whole parsed documents.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16 // That of TOMLValue and TOMLTable_Bucket, which malloc
+                       // only gives on some 64-bit targets
+#define align_up(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define STRINGS_PER_CHUNK 62
+
+struct TOMLArena_Block {
+  TOMLArena_Block *prev;
+  size_t           size;
+  size_t           used;
+  size_t           last; ///< Offset of the latest allocation, the only one
+                         ///< that can be grown in place.
+  char             data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+struct TOMLArena_Strings {
+  TOMLArena_Strings *next;
+  int                count;
+  String             items[STRINGS_PER_CHUNK];
+};
+
+static TOMLArena_Block *new_block(size_t size)
+{
+  void *mem;
+  if (posix_memalign(&(mem), ARENA_ALIGN,
+                     offsetof(TOMLArena_Block, data) + size) != 0)
+  {
+    return NULL;
+  }
+  TOMLArena_Block *const block = mem;
+  block->prev = NULL;
+  block->size = size;
+  block->used = 0;
+  block->last = 0;
+  return block;
+}
+
+void TOMLArena_init(TOMLArena *arena, size_t block_size)
+{
+  arena->blocks = NULL;
+  arena->strings = NULL;
+  arena->block_size = align_up(block_size == 0 ? TOML_ARENA_BLOCK_SIZE :
+                                                 block_size);
+}
+
+/**
+ * @brief Allocates `size` bytes from the arena.
+ * @returns `NULL` if the system is out of memory.
+ */
+void *TOMLArena_alloc(TOMLArena *arena, size_t size)
+{
+  TOMLArena_Block *block = arena->blocks;
+  size = align_up(size);
+  if (block == NULL || block->size - block->used < size)
+  {
+    if (size > arena->block_size / 4 && block != NULL)
+    {
+      // Big allocations get a block of their own, which is linked behind the
+      // current one so that what is left of it doesn't go to waste.
+      TOMLArena_Block *big = new_block(size);
+      if (big == NULL)
+      {
+        return NULL;
+      }
+      big->used = size;
+      big->prev = block->prev;
+      block->prev = big;
+      return big->data;
+    }
+    block = new_block(size > arena->block_size ? size : arena->block_size);
+    if (block == NULL)
+    {
+      return NULL;
+    }
+    block->prev = arena->blocks;
+    arena->blocks = block;
+  }
+  void *ptr = block->data + block->used;
+  block->last = block->used;
+  block->used += size;
+  return ptr;
+}
+
+/**
+ * @brief Grows an allocation made from the arena.
+ *
+ * The latest allocation is grown in place if the current block has room for
+ * it, otherwise the contents are copied into a new allocation and the old one
+ * is left to be freed along with the arena.
+ */
+void *TOMLArena_realloc(TOMLArena *arena, void *ptr,
+                        size_t old_size, size_t new_size)
+{
+  TOMLArena_Block *block = arena->blocks;
+  if (ptr == NULL)
+  {
+    return TOMLArena_alloc(arena, new_size);
+  }
+  if (block != NULL && ptr == block->data + block->last &&
+      block->last + align_up(new_size) <= block->size)
+  {
+    block->used = block->last + align_up(new_size);
+    return ptr;
+  } else if (new_size <= old_size)
+  {
+    return ptr;
+  }
+  void *new_ptr = TOMLArena_alloc(arena, new_size);
+  if (new_ptr != NULL)
+  {
+    memcpy(new_ptr, ptr, old_size);
+  }
+  return new_ptr;
+}
+
+/**
+ * @brief Makes the arena responsible for freeing `string`.
+ * @returns `0` on success, `-1` if the system is out of memory, in which case
+ *          the ownership of `string` stays with the caller.
+ */
+int TOMLArena_adopt(TOMLArena *arena, String string)
+{
+  TOMLArena_Strings *chunk = arena->strings;
+  if (chunk == NULL || chunk->count == STRINGS_PER_CHUNK)
+  {
+    chunk = TOMLArena_alloc(arena, sizeof(TOMLArena_Strings));
+    if (chunk == NULL)
+    {
+      return -1;
+    }
+    chunk->count = 0;
+    chunk->next = arena->strings;
+    arena->strings = chunk;
+  }
+  chunk->items[chunk->count++] = string;
+  return 0;
+}
+
+/**
+ * @brief Hands every block and every adopted string of `src` over to `dst`,
+ *        leaving `src` empty.
+ *
+ * The blocks of `src` are linked behind the one `dst` is bumping, which
+ * stays the one new allocations come from.
+ */
+void TOMLArena_absorb(TOMLArena *dst, TOMLArena *src)
+{
+  if (src->blocks != NULL)
+  {
+    TOMLArena_Block *first = src->blocks;
+    for (; first->prev != NULL; first = first->prev) {}
+    if (dst->blocks == NULL)
+    {
+      dst->blocks = src->blocks;
+    } else
+    {
+      first->prev = dst->blocks->prev;
+      dst->blocks->prev = src->blocks;
+    }
+  }
+  if (src->strings != NULL)
+  {
+    TOMLArena_Strings *last = src->strings;
+    for (; last->next != NULL; last = last->next) {}
+    last->next = dst->strings;
+    dst->strings = src->strings;
+  }
+  src->blocks = NULL;
+  src->strings = NULL;
+}
+
+void TOMLArena_destroy(TOMLArena *arena)
+{
+  // The string chunks live inside the blocks, so they go first.
+  for (TOMLArena_Strings *chunk = arena->strings; chunk != NULL;
+       chunk = chunk->next)
+  {
+    for (int i = 0; i < chunk->count; ++i)
+    {
+      String_cleanup(chunk->items[i]);
+    }
+  }
+  for (TOMLArena_Block *block = arena->blocks, *prev; block != NULL;
+       block = prev)
+  {
+    prev = block->prev;
+    free(block);
+  }
+  arena->blocks = NULL;
+  arena->strings = NULL;
+}
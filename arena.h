@@ -0,0 +1,49 @@
+/*
+ * @file arena.h
+ * @brief A bump allocator that owns a whole parsed document.
+ */
+
+#ifndef C_TOML_ARENA_H
+#define C_TOML_ARENA_H
+#include <stddef.h>
+#include <c-string/lib.h> // https://github.com/fabriciopashaj/c-string
+
+#define TOML_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct TOMLArena         TOMLArena;
+typedef struct TOMLArena_Block   TOMLArena_Block;
+typedef struct TOMLArena_Strings TOMLArena_Strings;
+
+/**
+ * @struct TOMLArena
+ * @brief A document-wide arena.
+ *
+ * When a @link TOMLCtx @endlink has an arena attached, every table and array
+ * the parser creates is bump-allocated from it and the whole document is
+ * released at once by @link TOMLArena_destroy @endlink, without walking it.
+ * Strings and keys still get their storage from c-string, since it owns their
+ * header, but the arena keeps track of them and frees them in the same call.
+ */
+struct TOMLArena {
+  TOMLArena_Block   *blocks;     ///< The block being bumped, linked to the
+                                 ///< previous ones.
+  TOMLArena_Strings *strings;    ///< The strings the arena has adopted.
+  size_t             block_size; ///< The size of a regular block.
+};
+
+void  TOMLArena_init   (TOMLArena *, size_t);
+void *TOMLArena_alloc  (TOMLArena *, size_t);
+void *TOMLArena_realloc(TOMLArena *, void *, size_t, size_t);
+int   TOMLArena_adopt  (TOMLArena *, String);
+void  TOMLArena_absorb (TOMLArena *, TOMLArena *);
+/**
+ * @fn TOMLArena_destroy(TOMLArena *arena)
+ * @brief Frees every block and every adopted string of `arena`.
+ *
+ * All the tables, arrays and strings of documents parsed with `arena` are
+ * invalid after this call. The arena can be reused after calling
+ * @link TOMLArena_init @endlink again.
+ */
+void  TOMLArena_destroy(TOMLArena *);
+
+#endif /* C_TOML_ARENA_H */
@@ -0,0 +1,355 @@
+#include <string.h>
+#include <malloc.h>
+#include "array.h"
+
+#define array_bytes(cap)                                          \
+  (offsetof(TOMLArray_Header, items) + (cap) * sizeof(TOMLValue))
+#define PACKED_MIN_CAP 8
+#define packed_bytes(kind, cap)                                   \
+  ((kind) == TOML_BOOLEAN ? ((cap) + 63) / 64 * sizeof(uint64_t) : \
+   (kind) == TOML_STRING  ? ((cap) + 1) * sizeof(uint32_t)       : \
+                            (cap) * sizeof(int64_t))
+
+TOMLArray TOMLArray_with_capacity_in(int cap, TOMLArena *arena)
+{
+  TOMLArray_Header *hdr = arena == NULL ?
+                          malloc(array_bytes(cap)) :
+                          TOMLArena_alloc(arena, array_bytes(cap));
+  TOMLArray array = NULL;
+  if (hdr != NULL)
+  {
+    hdr->len = 0;
+    hdr->cap = cap;
+    hdr->arena = arena;
+    array = &(hdr->items[0]);
+  }
+  return array;
+}
+
+static int TOMLArray_grow(TOMLArray *array_p)
+{
+  TOMLArray_Header *hdr = TOMLArray_header(*array_p);
+  int new_cap = hdr->cap < 4 ? 4 : hdr->cap * 2;
+  hdr = hdr->arena == NULL ?
+        realloc(hdr, array_bytes(new_cap)) :
+        TOMLArena_realloc(hdr->arena, hdr,
+                          array_bytes(hdr->cap), array_bytes(new_cap));
+  if (hdr == NULL)
+  {
+    return -1;
+  }
+  hdr->cap = new_cap;
+  *array_p = &(hdr->items[0]);
+  return 0;
+}
+
+/**
+ * @brief Appends a zeroed value to the array.
+ * @returns The address of the new value or `NULL` if the system is out of
+ *          memory.
+ */
+TOMLValue *TOMLArray_push_empty(TOMLArray *array_p)
+{
+  TOMLArray_Header *hdr = TOMLArray_header(*array_p);
+  if (hdr->len == hdr->cap)
+  {
+    if (TOMLArray_grow(array_p) != 0)
+    {
+      return NULL;
+    }
+    hdr = TOMLArray_header(*array_p);
+  }
+  TOMLValue *val_p = &((*array_p)[hdr->len++]);
+  memset(val_p, '\0', sizeof(TOMLValue));
+  return val_p;
+}
+
+int TOMLArray_push(TOMLArray *array_p, TOMLValue const *val_p)
+{
+  TOMLValue *slot = TOMLArray_push_empty(array_p);
+  if (slot == NULL)
+  {
+    return -1;
+  }
+  *slot = *val_p;
+  return 0;
+}
+
+void TOMLArray_cleanup(TOMLArray array)
+{
+  if (array != NULL && TOMLArray_header(array)->arena == NULL)
+  {
+    free(TOMLArray_header(array));
+  }
+}
+
+/**
+ * @brief Calls @link TOMLValue_destroy @endlink on all the items and frees
+ *        the array.
+ *
+ * Arrays that live in an arena are left alone, they are freed along with it.
+ */
+void TOMLArray_destroy(TOMLArray array)
+{
+  if (array == NULL || TOMLArray_header(array)->arena != NULL)
+  {
+    return;
+  }
+  for (int i = 0, len = TOMLArray_len(array); i < len; ++(i))
+  {
+    TOMLValue_destroy(&(array[i]));
+  }
+  TOMLArray_cleanup(array);
+}
+
+/*
+ * @brief Grows a buffer of a packed array to `new_size` bytes.
+ */
+static void *packed_realloc(TOMLArena *arena, void *ptr,
+                            size_t old_size, size_t new_size)
+{
+  return arena == NULL ? realloc(ptr, new_size) :
+                         TOMLArena_realloc(arena, ptr, old_size, new_size);
+}
+
+/**
+ * @brief Tells what kind of packed array values of `kind` can go in.
+ * @returns @link TOML_STRING @endlink for string views and short strings,
+ *          `0` for the kinds that can't be packed.
+ */
+TOMLKind TOMLPackedArray_kind_of(TOMLKind kind)
+{
+  switch (kind)
+  {
+    case TOML_INTEGER:
+    case TOML_FLOAT:
+    case TOML_BOOLEAN:
+    case TOML_STRING:
+      return kind;
+    case TOML_STRING_VIEW:
+    case TOML_SHORT_STRING:
+      return TOML_STRING;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Makes an empty packed array for items of `kind`.
+ * @returns `NULL` if `kind` can't be packed or the system is out of memory.
+ */
+TOMLPackedArray TOMLPackedArray_new_in(TOMLKind kind, TOMLArena *arena)
+{
+  if (TOMLPackedArray_kind_of(kind) != kind || kind == 0)
+  {
+    return NULL;
+  }
+  size_t const size = sizeof(TOMLPackedArray_Header);
+  TOMLPackedArray packed = arena == NULL ? malloc(size) :
+                                           TOMLArena_alloc(arena, size);
+  if (packed != NULL)
+  {
+    *packed = (TOMLPackedArray_Header) { .kind = kind, .arena = arena };
+  }
+  return packed;
+}
+
+/*
+ * @brief Appends the `len` bytes at `src` and a null byte to the strings of
+ *        `packed`.
+ */
+static int push_chars(TOMLPackedArray packed, char const *src, int len)
+{
+  if (packed->chars_len + len + 1 > packed->chars_cap)
+  {
+    int cap = packed->chars_cap < 64 ? 64 : packed->chars_cap;
+    for (; packed->chars_len + len + 1 > cap; cap *= 2) {}
+    char *chars = packed_realloc(packed->arena, packed->chars,
+                                 packed->chars_cap, cap);
+    if (chars == NULL)
+    {
+      return -1;
+    }
+    packed->chars = chars;
+    packed->chars_cap = cap;
+  }
+  memcpy(packed->chars + packed->chars_len, src, len);
+  packed->chars[packed->chars_len + len] = '\0';
+  packed->chars_len += len + 1;
+  return 0;
+}
+
+/**
+ * @brief Appends a copy of `val_p`, which has to be of the kind of the items
+ *        of `packed`, see @link TOMLPackedArray_kind_of @endlink.
+ * @returns `0` on success, `-1` if the system is out of memory.
+ *
+ * Strings are copied, so `val_p` keeps its own.
+ */
+int TOMLPackedArray_push(TOMLPackedArray packed, TOMLValue const *val_p)
+{
+  int const i = packed->len;
+  if (i == packed->cap)
+  {
+    int const cap = packed->cap < PACKED_MIN_CAP ?
+                    PACKED_MIN_CAP : packed->cap * 2;
+    void *data = packed_realloc(packed->arena, packed->data,
+                                packed_bytes(packed->kind, packed->cap),
+                                packed_bytes(packed->kind, cap));
+    if (data == NULL)
+    {
+      return -1;
+    }
+    packed->data = data;
+    packed->cap = cap;
+  }
+  switch (packed->kind)
+  {
+    case TOML_INTEGER:
+    {
+      ((int64_t *)packed->data)[i] = val_p->integer;
+    } break;
+    case TOML_FLOAT:
+    {
+      ((double *)packed->data)[i] = val_p->float_;
+    } break;
+    case TOML_BOOLEAN:
+    {
+      uint64_t *word = &(((uint64_t *)packed->data)[i / 64]);
+      uint64_t const bit = UINT64_C(1) << (i % 64);
+      *word = val_p->integer ? *word | bit : *word & ~bit;
+    } break;
+    case TOML_STRING:
+    {
+      uint32_t *offsets = packed->data;
+      TOMLStringView const view = TOMLValue_string(val_p);
+      if (push_chars(packed, view.data, view.len) != 0)
+      {
+        return -1;
+      }
+      offsets[0] = 0;
+      offsets[i + 1] = packed->chars_len;
+    } break;
+    default:
+      break;
+  }
+  ++(packed->len);
+  return 0;
+}
+
+/**
+ * @brief Sets `val_p` to the `i`th item of `packed`. Strings are given as
+ *        @link TOML_STRING_VIEW @endlink values borrowed from `packed`.
+ */
+void TOMLPackedArray_get(TOMLPackedArray packed, int i, TOMLValue *val_p)
+{
+  memset(val_p, '\0', sizeof(TOMLValue));
+  val_p->kind = packed->kind;
+  switch (packed->kind)
+  {
+    case TOML_INTEGER:
+    {
+      val_p->integer = ((int64_t *)packed->data)[i];
+    } break;
+    case TOML_FLOAT:
+    {
+      val_p->float_ = ((double *)packed->data)[i];
+    } break;
+    case TOML_BOOLEAN:
+    {
+      val_p->integer = TOMLPackedArray_boolean(packed, i);
+    } break;
+    case TOML_STRING:
+    {
+      val_p->kind = TOML_STRING_VIEW;
+      val_p->view = TOMLPackedArray_string(packed, i);
+    } break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @returns The items of `packed`, `NULL` if they aren't integers or there
+ *          are none.
+ */
+int64_t const *TOMLPackedArray_integers(TOMLPackedArray packed)
+{
+  return packed->kind == TOML_INTEGER ? packed->data : NULL;
+}
+
+/**
+ * @returns The items of `packed`, `NULL` if they aren't floats or there are
+ *          none.
+ */
+double const *TOMLPackedArray_floats(TOMLPackedArray packed)
+{
+  return packed->kind == TOML_FLOAT ? packed->data : NULL;
+}
+
+/**
+ * @returns The items of `packed` as a bitset, the `i`th one being bit
+ *          `i % 64` of word `i / 64`, `NULL` if they aren't booleans or
+ *          there are none.
+ */
+uint64_t const *TOMLPackedArray_booleans(TOMLPackedArray packed)
+{
+  return packed->kind == TOML_BOOLEAN ? packed->data : NULL;
+}
+
+/**
+ * @returns The `i`th string of `packed`, which is null terminated, or an
+ *          empty view if the items aren't strings.
+ */
+TOMLStringView TOMLPackedArray_string(TOMLPackedArray packed, int i)
+{
+  if (packed->kind != TOML_STRING)
+  {
+    return (TOMLStringView) { NULL, 0 };
+  }
+  uint32_t const *offsets = packed->data;
+  return (TOMLStringView) {
+    .data = packed->chars + offsets[i],
+    .len = offsets[i + 1] - offsets[i] - 1
+  };
+}
+
+/**
+ * @brief Hands the buffers of `packed` over to the caller and empties it.
+ * @param chars_p If not `NULL`, set to the bytes of the strings, which the
+ *                offsets returned point into.
+ * @returns What `data` was, see @link TOMLPackedArray_Header @endlink.
+ *
+ * The caller has to `free` the buffers, unless the array lives in an arena,
+ * in which case they are freed along with it.
+ */
+void *TOMLPackedArray_release(TOMLPackedArray packed, char **chars_p)
+{
+  void *const data = packed->data;
+  if (chars_p != NULL)
+  {
+    *chars_p = packed->chars;
+  } else if (packed->arena == NULL)
+  {
+    free(packed->chars);
+  }
+  packed->data = NULL;
+  packed->chars = NULL;
+  packed->len = packed->cap = 0;
+  packed->chars_len = packed->chars_cap = 0;
+  return data;
+}
+
+/**
+ * @brief Frees `packed` and its buffers, unless it lives in an arena.
+ */
+void TOMLPackedArray_destroy(TOMLPackedArray packed)
+{
+  if (packed == NULL || packed->arena != NULL)
+  {
+    return;
+  }
+  free(packed->data);
+  free(packed->chars);
+  free(packed);
+}
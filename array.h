@@ -0,0 +1,71 @@
+#ifndef __TOML_TOMLARRAY_H__
+#define __TOML_TOMLARRAY_H__
+#include <stddef.h>
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+
+typedef struct TOMLArray_Header {
+  int        len;
+  int        cap;
+  TOMLArena *arena; ///< The arena the array lives in, `NULL` if on the heap.
+  TOMLValue  items[1];
+} TOMLArray_Header;
+
+TOMLArray TOMLArray_with_capacity_in(int, TOMLArena *);
+#define TOMLArray_with_capacity(cap) TOMLArray_with_capacity_in(cap, NULL)
+#define TOMLArray_new_in(arena) TOMLArray_with_capacity_in(4, arena)
+#define TOMLArray_new() TOMLArray_new_in(NULL)
+TOMLValue *TOMLArray_push_empty(TOMLArray *);
+int TOMLArray_push(TOMLArray *, TOMLValue const *);
+void TOMLArray_cleanup(TOMLArray);
+void TOMLArray_destroy(TOMLArray);
+#define TOMLArray_header(a)                                     \
+  ((TOMLArray_Header *)((void *)(a) -                           \
+    offsetof(TOMLArray_Header, items)))
+#define TOMLArray_len(a) (TOMLArray_header(a)->len)
+#define TOMLArray_cap(a) (TOMLArray_header(a)->cap)
+
+/**
+ * @struct TOMLPackedArray_Header
+ * @brief An array whose items are all integers, all floats, all booleans or
+ *        all strings, stored unboxed.
+ *
+ * `data` holds an `int64_t` per integer, a `double` per float or a bit per
+ * boolean, in `uint64_t` words. The strings are kept one after the other in
+ * `chars`, each followed by a null byte, and `data` holds the `uint32_t`
+ * offset each of them starts at plus the one the next would start at.
+ *
+ * The parser makes arrays like these when the context has
+ * @link TOML_F_PACK_ARRAYS @endlink set.
+ */
+typedef struct TOMLPackedArray_Header {
+  int        len;
+  int        cap;
+  TOMLKind   kind;      ///< The kind of the items.
+  TOMLArena *arena;     ///< The arena the array lives in, `NULL` if on the
+                        ///< heap.
+  void      *data;
+  char      *chars;     ///< The bytes of the strings.
+  int        chars_len;
+  int        chars_cap;
+} TOMLPackedArray_Header;
+
+TOMLKind TOMLPackedArray_kind_of(TOMLKind);
+TOMLPackedArray TOMLPackedArray_new_in(TOMLKind, TOMLArena *);
+#define TOMLPackedArray_new(kind) TOMLPackedArray_new_in(kind, NULL)
+int TOMLPackedArray_push(TOMLPackedArray, TOMLValue const *);
+void TOMLPackedArray_get(TOMLPackedArray, int, TOMLValue *);
+int64_t const *TOMLPackedArray_integers(TOMLPackedArray);
+double const *TOMLPackedArray_floats(TOMLPackedArray);
+uint64_t const *TOMLPackedArray_booleans(TOMLPackedArray);
+TOMLStringView TOMLPackedArray_string(TOMLPackedArray, int);
+void *TOMLPackedArray_release(TOMLPackedArray, char **);
+void TOMLPackedArray_destroy(TOMLPackedArray);
+#define TOMLPackedArray_len(a) ((a)->len)
+#define TOMLPackedArray_kind(a) ((a)->kind)
+/// The `i`th item of a packed array of booleans.
+#define TOMLPackedArray_boolean(a, i)                           \
+  ((int)((TOMLPackedArray_booleans(a)[(i) / 64] >> ((i) % 64)) & 1))
+
+#endif /* __TOML_TOMLARRAY_H__ */
@@ -0,0 +1,198 @@
+/*
+ * @file batch.c
+ * @brief Parsing many files at once on a pool of threads.
+ *
+ * Each worker starts with an equal run of the files and takes them from the
+ * front of it. A worker whose run is used up steals the back half of the run
+ * of another, so a few big files don't keep the rest of the pool waiting.
+ * A run is the pair of its bounds packed in one word, which both its owner
+ * and the thieves move with a compare-and-swap.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "pool.h"
+
+#define RUN(start, end) (((uint64_t)(end) << 32) | (uint32_t)(start))
+#define RUN_START(run)  ((int)(uint32_t)(run))
+#define RUN_END(run)    ((int)((run) >> 32))
+
+typedef struct Batch  Batch;
+typedef struct Worker Worker;
+
+struct Batch {
+  char const *const *paths;
+  TOMLFileResult    *results;
+  TOMLArena         *arena;
+  int                flags;
+  TOMLInterner      *keys;
+  Worker            *workers;
+  int                count;   ///< The number of workers.
+};
+
+struct Worker {
+  TOMLPool_Worker base;
+  Batch          *batch;
+  uint64_t        run;   ///< The files the worker has yet to parse.
+  TOMLCtx         ctx;   ///< Reused for every file the worker parses.
+};
+
+/*
+ * @brief Takes the file at the front of the run of `worker`.
+ * @returns The index of the file, `-1` if the run is empty.
+ */
+static int take(Worker *worker)
+{
+  uint64_t run = __atomic_load_n(&(worker->run), __ATOMIC_ACQUIRE);
+  while (RUN_START(run) < RUN_END(run))
+  {
+    if (__atomic_compare_exchange_n(&(worker->run), &(run),
+                                    RUN(RUN_START(run) + 1, RUN_END(run)), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      return RUN_START(run);
+    }
+  }
+  return -1;
+}
+
+/*
+ * @brief Moves the back half of the run of some other worker over to the
+ *        empty run of `worker`.
+ * @returns Whether there was anything left to steal.
+ */
+static int steal(Worker *worker)
+{
+  Batch *const batch = worker->batch;
+  int const self = worker - batch->workers;
+  for (int i = 1; i < batch->count; ++(i))
+  {
+    Worker *const victim = &(batch->workers[(self + i) % batch->count]);
+    uint64_t run = __atomic_load_n(&(victim->run), __ATOMIC_ACQUIRE);
+    while (RUN_START(run) < RUN_END(run))
+    {
+      int const start = RUN_START(run);
+      int const end = RUN_END(run);
+      int const split = end - (end - start + 1) / 2;
+      if (__atomic_compare_exchange_n(&(victim->run), &(run),
+                                      RUN(start, split), 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      {
+        // Nobody steals from an empty run, so a plain store will do.
+        __atomic_store_n(&(worker->run), RUN(split, end), __ATOMIC_RELEASE);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+ * @brief Parses the `i`th file of the batch into its result.
+ */
+static void parse_one(Worker *worker, int i)
+{
+  Batch *const batch = worker->batch;
+  TOMLFileResult *const result = &(batch->results[i]);
+  TOMLArena *const arena = batch->arena == NULL ?
+                           NULL : &(worker->base.arena);
+  memset(result, '\0', sizeof(TOMLFileResult));
+  result->table = TOMLTable_new_in(arena);
+  if (result->table == NULL)
+  {
+    result->status = TOML_E_OOM;
+    return;
+  }
+  result->status = TOML_parse_file(&(worker->ctx), batch->paths[i], arena,
+                                   batch->flags, batch->keys,
+                                   &(result->table));
+  if (result->status != TOML_E_OK)
+  {
+    if (result->status != TOML_E_IO)
+    {
+      result->position = TOML_position(&(worker->ctx));
+    }
+    TOMLTable_destroy(result->table);
+    result->table = NULL;
+  }
+  TOML_unmap(&(worker->ctx));
+}
+
+/*
+ * @brief Parses files until there are none left to take or steal.
+ */
+static void *work(void *arg)
+{
+  Worker *const worker = arg;
+  do
+  {
+    for (int i; (i = take(worker)) >= 0; )
+    {
+      parse_one(worker, i);
+    }
+  } while (steal(worker));
+  return NULL;
+}
+
+/**
+ * @brief Parses each of the `n` files at `paths` into the matching one of
+ *        `results`, on `threads` threads.
+ * @param arena The arena to allocate the parsed values from, or `NULL`.
+ * @param flags The `TOML_F_*` flags to parse with, but
+ *              @link TOML_F_ZERO_COPY @endlink, since the files are unmapped
+ *              once parsed.
+ * @param keys The interner to put the keys through, or `NULL`. The files
+ *             are then parsed on the calling thread, since interners aren't
+ *             thread-safe.
+ * @param threads How many threads to use, `0` for one per processor.
+ * @returns The status of the first file in `paths` that failed, or
+ *          @link TOML_E_OOM @endlink if the pool couldn't be made, in which
+ *          case `results` is left alone.
+ *
+ * The table of a file that failed is `NULL`, and the position of its error
+ * is kept along with its status. When there is an arena, each thread
+ * allocates from an arena of its own, which is handed over to `arena` once
+ * every file is parsed.
+ */
+TOMLStatus TOML_parse_many(
+  char const *const *paths, int n, TOMLArena *arena, int flags,
+  TOMLInterner *keys, TOMLFileResult *results, int threads
+)
+{
+  threads = TOML_pool_threads(keys == NULL ? threads : 1, n);
+  Worker *workers = calloc(threads, sizeof(Worker));
+  if (workers == NULL)
+  {
+    return TOML_E_OOM;
+  }
+  Batch batch = {
+    .paths = paths,
+    .results = results,
+    .arena = arena,
+    .flags = flags & ~TOML_F_ZERO_COPY,
+    .keys = keys,
+    .workers = workers,
+    .count = threads
+  };
+  for (int i = 0; i < threads; ++(i))
+  {
+    workers[i].batch = &(batch);
+    workers[i].run = RUN((long)n * i / threads, (long)n * (i + 1) / threads);
+  }
+  TOML_pool_run(workers, sizeof(Worker), threads, arena, work);
+
+  TOMLStatus status = TOML_E_OK;
+  for (int i = 0; i < n; ++(i))
+  {
+    status = status == TOML_E_OK ? results[i].status : status;
+    if (arena != NULL && results[i].table != NULL)
+    {
+      TOML_pool_rehome(results[i].table, arena);
+    }
+  }
+  TOML_pool_finish(workers, sizeof(Worker), threads, arena);
+  free(workers);
+  return status;
+}
@@ -0,0 +1,47 @@
+/*
+ * @file doc.h
+ * @brief Documents whose values are decoded on first access.
+ */
+
+#ifndef C_TOML_DOC_H
+#define C_TOML_DOC_H
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+
+typedef struct TOMLDoc TOMLDoc;
+
+/**
+ * @struct TOMLDoc
+ * @brief A document of which only the tables and the keys are built up
+ *        front.
+ *
+ * @link TOMLDoc_open @endlink indexes the content and puts every key in its
+ * table, but the values of the entries are left as @link TOML_LAZY @endlink
+ * spans, which @link TOMLDoc_get @endlink decodes in place the first time
+ * they are looked up. Arrays and inline tables are decoded whole. Errors in
+ * a value are only reported when it is decoded.
+ *
+ * The content has to outlive the document, keys are borrowed from it unless
+ * they have escapes. Looking values up modifies the document, so it can't be
+ * shared between threads without a lock.
+ */
+struct TOMLDoc {
+  TOMLCtx   ctx;  ///< A copy of the context the document was opened with,
+                  ///< its cursor tells where the last error is.
+  TOMLTape  tape;
+  TOMLTable root;
+};
+
+TOMLStatus TOMLDoc_open    (TOMLDoc *, TOMLCtx const *);
+TOMLStatus TOMLDoc_get     (TOMLDoc *, TOMLTable, String, TOMLValue const **);
+TOMLStatus TOMLDoc_get_view(TOMLDoc *, TOMLTable, TOMLStringView,
+                            TOMLValue const **);
+/**
+ * @fn TOMLDoc_destroy(TOMLDoc *doc)
+ * @brief Frees the tape and the tree of `doc`, unless the tree lives in an
+ *        arena.
+ */
+void       TOMLDoc_destroy (TOMLDoc *);
+
+#endif /* C_TOML_DOC_H */
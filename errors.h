@@ -40,6 +40,8 @@ char const *format_of_error(TOMLStatus status)
     CASE(INVALID_TIME, "Time value is invalid.");
     CASE(INVALID_DATETIME, "Datetime value is invalid.");
     CASE(INVALID_HEX_ESCAPE, "Hexadecimal escape sequence is invalid.");
+    CASE(IO, "File could not be read.");
+    CASE(SECTION_TOO_BIG, "Section is longer than the limit of the stream.");
   }
 #undef CASE
   return fmt;
@@ -0,0 +1,49 @@
+/*
+ * @file events.h
+ * @brief The event interface of the parser.
+ */
+
+#ifndef C_TOML_EVENTS_H
+#define C_TOML_EVENTS_H
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+
+#define TOML_EVENTS_MAX_KEYS 32 ///< The most parts a dotted key can have.
+
+typedef struct TOMLEvents TOMLEvents;
+
+/**
+ * @struct TOMLEvents
+ * @brief The callbacks @link TOML_parse_events @endlink calls as it goes
+ *        through a document, in document order.
+ *
+ * Any callback can be `NULL` to ignore its events. The keys and strings
+ * passed to them are only valid during the call. Returning anything but
+ * @link TOML_E_OK @endlink stops the parser, which returns the same status.
+ *
+ * No tree is built, so defining a key or a table twice isn't detected, that
+ * is left to the consumer.
+ */
+struct TOMLEvents {
+  void *data; ///< Passed as the first argument of every callback.
+  /// A `[a.b]` header, or a `[[a.b]]` one if the last argument is `1`.
+  TOMLStatus (*on_table_header)(void *, TOMLStringView const *, int, int);
+  /// The (dotted) key of an entry, followed by the events of its value.
+  TOMLStatus (*on_key)(void *, TOMLStringView const *, int);
+  TOMLStatus (*on_integer)(void *, signed long);
+  TOMLStatus (*on_float)(void *, double);
+  TOMLStatus (*on_boolean)(void *, bool);
+  TOMLStatus (*on_string)(void *, TOMLStringView);
+  /// A @link TOML_DATE @endlink, @link TOML_TIME @endlink or
+  /// @link TOML_DATETIME @endlink value.
+  TOMLStatus (*on_datetime)(void *, TOMLValue const *);
+  TOMLStatus (*on_array_begin)(void *);
+  TOMLStatus (*on_array_end)(void *);
+  TOMLStatus (*on_inline_table_begin)(void *);
+  TOMLStatus (*on_inline_table_end)(void *);
+};
+
+TOMLStatus TOML_parse_events(TOMLCtx *, TOMLEvents const *);
+
+#endif /* C_TOML_EVENTS_H */
@@ -0,0 +1,122 @@
+/*
+ * @file file.c
+ * @brief Loading TOML files by mapping them into memory.
+ */
+
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lib.h"
+
+/*
+ * @brief Reserves room for the file plus `TOML_MMAP_PADDING` bytes and maps
+ *        the file over the start of it.
+ *
+ * The bytes past the end of the file are zero, whether they are the rest of
+ * the file's last page or the anonymous pages behind it, so the parser can
+ * look ahead of `ctx->end` and `strchr` always finds a terminator.
+ */
+static char *map_file(int fd, size_t size, size_t *mapped_p)
+{
+  size_t const page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t const mapped = (size + TOML_MMAP_PADDING + page - 1) & ~(page - 1);
+  char *base = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+  if (base == MAP_FAILED)
+  {
+    return NULL;
+  }
+  if (size > 0 &&
+      mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+      MAP_FAILED)
+  {
+    munmap(base, mapped);
+    return NULL;
+  }
+  *mapped_p = mapped;
+  return base;
+}
+
+/**
+ * @brief Initializes a parsing context with the contents of the file at
+ *        `path`, mapped read-only into memory instead of being copied.
+ * @param arena The arena to allocate the parsed values from, or `NULL`.
+ * @returns @link TOML_E_IO @endlink if the file can't be opened or mapped,
+ *          `errno` tells why.
+ *
+ * The mapping is released by @link TOML_unmap @endlink, after the strings
+ * borrowed from it are no longer used.
+ *
+ * The mapping is private but isn't a copy: pages that weren't read yet, and
+ * the strings borrowed from them with @link TOML_F_ZERO_COPY @endlink, show
+ * what the file holds when they are read. A file that is written over while
+ * mapped changes under the parser and the document, and touching a page
+ * past its end after it shrinks raises `SIGBUS`. Files that may be rewritten
+ * while in use are better parsed without borrowing, and unmapped right away.
+ */
+TOMLStatus TOML_init_mmap(TOMLCtx *ctx, char const *path, TOMLArena *arena)
+{
+  TOMLStatus status = TOML_E_OK;
+  struct stat st;
+  size_t mapped = 0;
+  char *base = NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return TOML_E_IO;
+  }
+  if (fstat(fd, &(st)) != 0 ||
+      (base = map_file(fd, (size_t)st.st_size, &(mapped))) == NULL)
+  {
+    status = TOML_E_IO;
+  } else
+  {
+    ctx->content = base;
+    ctx->end = base + st.st_size;
+    ctx->offset = base;
+    ctx->arena = arena;
+    ctx->flags = 0;
+    ctx->keys = NULL;
+    ctx->mapped = mapped;
+  }
+  close(fd);
+  return status;
+}
+
+/**
+ * @brief Maps the file at `path` and parses it into `*table_p`.
+ * @param flags The `TOML_F_*` flags to parse with.
+ * @param keys The interner to put the keys through, or `NULL`.
+ *
+ * `ctx` keeps the mapping whether parsing succeeds or not, so that
+ * @link TOML_position @endlink can locate errors. Release it with
+ * @link TOML_unmap @endlink.
+ */
+TOMLStatus TOML_parse_file(
+  TOMLCtx *ctx, char const *path, TOMLArena *arena, int flags,
+  TOMLInterner *keys, TOMLTable *table_p
+)
+{
+  TOMLStatus status = TOML_init_mmap(ctx, path, arena);
+  if (status == TOML_E_OK)
+  {
+    ctx->flags = flags;
+    ctx->keys = keys;
+    status = TOML_parse(ctx, table_p);
+  }
+  return status;
+}
+
+void TOML_unmap(TOMLCtx *ctx)
+{
+  if (ctx->mapped != 0)
+  {
+    munmap(ctx->content, ctx->mapped);
+    ctx->content = NULL;
+    ctx->end = NULL;
+    ctx->offset = NULL;
+    ctx->mapped = 0;
+  }
+}
@@ -0,0 +1,118 @@
+/*
+ * @file hash.c
+ * @brief The hash function of the tables and the key interner.
+ */
+
+#include <string.h>
+#include "hash.h"
+
+#if defined(TOML_HASH_WYHASH)
+
+// The default secret of wyhash
+static uint64_t const wyp[4] = {
+  UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+  UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47)
+};
+
+static void wymum(uint64_t *a, uint64_t *b)
+{
+  __uint128_t const r = (__uint128_t)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+}
+
+static uint64_t wymix(uint64_t a, uint64_t b)
+{
+  wymum(&(a), &(b));
+  return a ^ b;
+}
+
+static uint64_t wyr8(uint8_t const *p)
+{
+  uint64_t v;
+  memcpy(&(v), p, 8);
+  return v;
+}
+
+static uint64_t wyr4(uint8_t const *p)
+{
+  uint32_t v;
+  memcpy(&(v), p, 4);
+  return v;
+}
+
+/*
+ * @brief Reads the first, the middle and the last of the `len` bytes at `p`,
+ *        which are 1 to 3.
+ */
+static uint64_t wyr3(uint8_t const *p, size_t len)
+{
+  return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+uint32_t TOML_hash(void const *data, size_t len, uint32_t seed_32)
+{
+  uint8_t const *p = data;
+  uint64_t seed = seed_32 ^ wymix(seed_32 ^ wyp[0], wyp[1]);
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      size_t const mid = (len >> 3) << 2;
+      a = (wyr4(p) << 32) | wyr4(p + mid);
+      b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - mid);
+    } else if (len > 0)
+    {
+      a = wyr3(p, len);
+    }
+  } else
+  {
+    size_t i = len;
+    if (i > 48)
+    {
+      uint64_t see1 = seed;
+      uint64_t see2 = seed;
+      do
+      {
+        seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+        see1 = wymix(wyr8(p + 16) ^ wyp[2], wyr8(p + 24) ^ see1);
+        see2 = wymix(wyr8(p + 32) ^ wyp[3], wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    for (; i > 16; p += 16, i -= 16)
+    {
+      seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+    }
+    a = wyr8(p + i - 16);
+    b = wyr8(p + i - 8);
+  }
+  a ^= wyp[1];
+  b ^= seed;
+  wymum(&(a), &(b));
+  uint64_t const hash = wymix(a ^ wyp[0] ^ len, b ^ wyp[1]);
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+#elif defined(TOML_HASH_XXH3)
+#include <xxhash.h>
+
+uint32_t TOML_hash(void const *data, size_t len, uint32_t seed)
+{
+  uint64_t const hash = XXH3_64bits_withSeed(data, len, seed);
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+#else
+#include <xxhash.h>
+
+uint32_t TOML_hash(void const *data, size_t len, uint32_t seed)
+{
+  return XXH32(data, len, seed);
+}
+
+#endif
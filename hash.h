@@ -0,0 +1,22 @@
+/*
+ * @file hash.h
+ * @brief The hash function of the tables and the key interner.
+ */
+
+#ifndef C_TOML_HASH_H
+#define C_TOML_HASH_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @fn TOML_hash(void const *data, size_t len, uint32_t seed)
+ * @brief Hashes the `len` bytes at `data`.
+ *
+ * XXH32 by default, XXH3 when built with `TOML_HASH_XXH3` or wyhash when
+ * built with `TOML_HASH_WYHASH`, the 64-bit ones folded to 32 bits. Keys
+ * hashed ahead of time with seed `0`, like the ones of a
+ * @link TOMLKey @endlink, are only valid for the build they were hashed in.
+ */
+uint32_t TOML_hash(void const *, size_t, uint32_t);
+
+#endif /* C_TOML_HASH_H */
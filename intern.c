@@ -0,0 +1,105 @@
+/*
+ * @file intern.c
+ * @brief The set of keys shared by the tables of a document.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "intern.h"
+
+#define INTERN_MIN_SIZE 64
+
+/**
+ * @brief Hashes the `len` bytes at `data` the way tables do, for looking
+ *        them up with @link TOMLTable_get_key @endlink. The key borrows
+ *        `data`.
+ */
+TOMLKey TOMLKey_make(char const *data, int len)
+{
+  uint32_t const hash = TOML_hash(data, len, 0);
+  return (TOMLKey) { .data = data, .len = len, .hash = hash };
+}
+
+void TOMLInterner_init(TOMLInterner *keys)
+{
+  TOMLArena_init(&(keys->storage), 0);
+  keys->slots = NULL;
+  keys->size = 0;
+  keys->count = 0;
+}
+
+static int grow(TOMLInterner *keys)
+{
+  int const size = keys->size == 0 ? INTERN_MIN_SIZE : keys->size * 2;
+  TOMLKey **slots = calloc(size, sizeof(TOMLKey *));
+  if (slots == NULL)
+  {
+    return -1;
+  }
+  for (int i = 0; i < keys->size; ++(i))
+  {
+    TOMLKey *key = keys->slots[i];
+    if (key != NULL)
+    {
+      size_t j = key->hash & (size - 1);
+      for (; slots[j] != NULL; j = (j + 1) & (size - 1)) {}
+      slots[j] = key;
+    }
+  }
+  free(keys->slots);
+  keys->slots = slots;
+  keys->size = size;
+  return 0;
+}
+
+/**
+ * @brief Finds the copy of the `len` bytes at `data` in the interner, making
+ *        one if there's none yet.
+ * @returns `NULL` if the system is out of memory.
+ */
+TOMLKey const *TOMLInterner_intern(TOMLInterner *keys, char const *data,
+                                   int len)
+{
+  uint32_t const hash = TOML_hash(data, len, 0);
+  if (keys->count * 4 >= keys->size * 3 && grow(keys) != 0)
+  {
+    return NULL;
+  }
+  size_t const mask = keys->size - 1;
+  size_t i = hash & mask;
+  for (; keys->slots[i] != NULL; i = (i + 1) & mask)
+  {
+    TOMLKey const *key = keys->slots[i];
+    if (key->hash == hash && key->len == len &&
+        memcmp(key->data, data, len) == 0)
+    {
+      return key;
+    }
+  }
+  TOMLKey *key = TOMLArena_alloc(&(keys->storage), sizeof(TOMLKey) + len + 1);
+  if (key == NULL)
+  {
+    return NULL;
+  }
+  char *const bytes = (char *)(key + 1);
+  memcpy(bytes, data, len);
+  bytes[len] = '\0';
+  *key = (TOMLKey) { .data = bytes, .len = len, .hash = hash };
+  keys->slots[i] = key;
+  ++(keys->count);
+  return key;
+}
+
+/**
+ * @brief Frees every key of the interner, which can be reused after calling
+ *        @link TOMLInterner_init @endlink again.
+ */
+void TOMLInterner_destroy(TOMLInterner *keys)
+{
+  free(keys->slots);
+  TOMLArena_destroy(&(keys->storage));
+  keys->slots = NULL;
+  keys->size = 0;
+  keys->count = 0;
+}
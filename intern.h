@@ -0,0 +1,53 @@
+/*
+ * @file intern.h
+ * @brief A set of keys shared by the tables of a document.
+ */
+
+#ifndef C_TOML_INTERN_H
+#define C_TOML_INTERN_H
+#include <stdint.h>
+#include "arena.h"
+
+typedef struct TOMLKey      TOMLKey;
+typedef struct TOMLInterner TOMLInterner;
+
+/**
+ * @struct TOMLKey
+ * @brief A key along with its hash, which tables reuse instead of hashing
+ *        the key again.
+ *
+ * Keys that are looked up often can be hashed once with
+ * @link TOMLKey_make @endlink and looked up with
+ * @link TOMLTable_get_key @endlink.
+ */
+struct TOMLKey {
+  char const *data; ///< The bytes of the key, followed by a null byte if
+                    ///< it's interned.
+  int         len;
+  uint32_t    hash;
+};
+
+/**
+ * @struct TOMLInterner
+ * @brief Keeps a single copy of every distinct key.
+ *
+ * When a @link TOMLCtx @endlink has an interner attached, the parser puts
+ * every key through it, so the tables of the document borrow the same copy
+ * of keys that repeat, like the ones of the tables of a table array, instead
+ * of allocating one each, and equal keys are told apart by their address.
+ * The interner has to outlive the tables, and can be shared by several
+ * documents.
+ */
+struct TOMLInterner {
+  TOMLArena  storage; ///< Where the keys are allocated.
+  TOMLKey  **slots;   ///< The keys, by hash with linear probing.
+  int        size;
+  int        count;
+};
+
+TOMLKey        TOMLKey_make        (char const *, int);
+void           TOMLInterner_init   (TOMLInterner *);
+TOMLKey const *TOMLInterner_intern (TOMLInterner *, char const *, int);
+void           TOMLInterner_destroy(TOMLInterner *);
+
+#endif /* C_TOML_INTERN_H */
@@ -11,13 +11,15 @@
 #include <limits.h>
 #include <c-ansi-sequences/graphics.h>
 #include "lib.h"
+#include "number.h"
+#include "scan.h"
 #include "util.h"
 
 #define __fallthrough__ __attribute__((fallthrough))
 #define OFFSET (ctx->offset)
-
-// TODO: [TOML_parse_number] Do more checks for value correctness,
-//                           Check for float overflows
+// Whether string values are parsed as views when they need no escapes
+#define borrow_strings(ctx) \
+  ((ctx)->flags & (TOML_F_ZERO_COPY | TOML_F_SHORT_STRINGS))
 
 // TODO: [TOML_parse_{m,s}l_string] Don't allocate a new string if the value
 //                                  pointed by `string` is not NULL.
@@ -25,9 +27,6 @@
 // TODO: [TOML_parse_array] Don't allocate a new array if the value
 //                                  pointed by `array` is not NULL.
 
-// XXX: Consider implementing unitype arrays for memory efficiency,
-//        may need to sacrifice some performance
-
 
 #define throw(err) { status = TOML_E_##err; goto catch; }
 #define try(thing) { status = (thing); if (status) { goto catch; } }
@@ -41,83 +40,102 @@
     offset = nln == NULL ? ctx->end : (nln);  \
   } while (0);
 
-#define PARSE_INT_NEG (1 << 0)
-#define PARSE_INT_ILZ (1 << 1) // (I)gnore (L)eading (Z)eroes
-static TOMLStatus parse_int(
-  char const **buf_p, char const *end, int base, int info, signed long *res_p
-)
+void TOML_init(TOMLCtx *ctx, StringBuffer input)
 {
-  TOMLStatus status = TOML_E_OK;
-  char const *buf = *buf_p;
-  signed long cutlim = ((info & PARSE_INT_NEG ? LONG_MIN : LONG_MAX) % base);
-  signed long cutoff = (info & PARSE_INT_NEG ? LONG_MIN : LONG_MAX) - cutlim;
-  register signed long acc = 0;
-  if (info & PARSE_INT_ILZ)
+  TOML_init_arena(ctx, input, NULL);
+}
+
+/**
+ * @brief Initializes a parsing context that allocates every table, array and
+ *        string it parses from `arena`.
+ *
+ * Such documents are freed with @link TOMLArena_destroy @endlink, calling
+ * @link TOMLTable_destroy @endlink on them does nothing.
+ */
+void TOML_init_arena(TOMLCtx *ctx, StringBuffer input, TOMLArena *arena)
+{
+  ctx->content = input;
+  ctx->end = input + StringBuffer_len(input);
+  ctx->offset = input;
+  ctx->arena = arena;
+  ctx->flags = 0;
+  ctx->keys = NULL;
+  ctx->mapped = 0;
+}
+
+/*
+ * @brief Hands a freshly parsed string over to the context's arena, if it has
+ *        one.
+ */
+static TOMLStatus adopt_string(TOMLCtx *ctx, String string)
+{
+  if (ctx->arena != NULL && TOMLArena_adopt(ctx->arena, string) != 0)
   {
-    for (; buf[0] == '0' && buf[1] == '0'; ++buf) {}
+    String_cleanup(string);
+    return TOML_E_OOM;
   }
-  for (; buf < end; ++(buf))
+  return TOML_E_OK;
+}
+
+/*
+ * @brief Frees a string that didn't make it into the document, unless it's
+ *        owned by the context's arena.
+ */
+static void drop_string(TOMLCtx *ctx, String string)
+{
+  if (ctx->arena == NULL && string != NULL)
   {
-    char c = *buf;
-    if (c == '_')
-    {
-      if (buf[-1] == '_')
-      {
-        --(buf);
-        break;
-      } else if (buf == *buf_p)
-      {
-        break;
-      }
-    } else if (base <= 10)
-    {
-      if (c >= '0' && c < '0' + base)
-      {
-        acc = acc * base + (c - '0');
-      } else
-      {
-        break;
-      }
-    } else
-    {
-      if (c >= '0' && c <= '9')
-      {
-        c  -= '0';
-      } else if (c >= 'A' && c < ('A' + base - 10))
-      {
-        c -= 'A' - 10;
-      } else if (c >= 'a' && c < ('a' + base - 10))
-      {
-        c -= 'a' - 10;
-      } else
-      {
-        break;
-      }
-      if (acc >= cutoff || c > cutlim)
-      {
-        status = TOML_E_INT_OVERFLOW;
-      }
-      if (c > base)
-      {
-        break;
-      } else
-      {
-        acc *= base;
-        acc += c;
-      }
-    }
+    String_cleanup(string);
   }
-  *buf_p = buf;
-  *res_p = info & PARSE_INT_NEG ? -acc : acc;
-  return status;
 }
 
-void TOML_init(TOMLCtx *ctx, StringBuffer input)
+/*
+ * @brief Allocates a String with the `len` bytes at `src`.
+ */
+static TOMLStatus make_string(TOMLCtx *ctx, char const *src, int len,
+                              String *string)
 {
-  TOMLStatus status = TOML_S_OK;
-  ctx->content = input;
-  ctx->end = input + StringBuffer_len(input);
-  ctx->offset = input;
+  StringBuffer buffer = StringBuffer_with_length(len);
+  if (buffer == NULL)
+  {
+    return TOML_E_OOM;
+  }
+  memcpy(buffer, src, len);
+  *string = StringBuffer_transform_to_string(&buffer);
+  return adopt_string(ctx, *string);
+}
+
+/*
+ * @brief Stores a parsed string in `value`: inline if it's short enough and
+ *        the context asks for it, borrowed if it can be, copied otherwise.
+ * @param string The parsed string, `NULL` if it was borrowed as `view`.
+ */
+static TOMLStatus set_string(TOMLCtx *ctx, TOMLValue *value, String string,
+                             TOMLStringView view)
+{
+  if (string != NULL)
+  {
+    view = (TOMLStringView) { .data = string, .len = String_len(string) };
+  }
+  if (ctx->flags & TOML_F_SHORT_STRINGS && view.len <= TOML_SHORT_STRING_MAX)
+  {
+    value->kind = TOML_SHORT_STRING;
+    memcpy(value->short_string, view.data, view.len);
+    value->short_string[view.len] = '\0';
+    value->short_string[TOML_SHORT_STRING_MAX] =
+      TOML_SHORT_STRING_MAX - view.len;
+    drop_string(ctx, string);
+    return TOML_E_OK;
+  } else if (string == NULL && ctx->flags & TOML_F_ZERO_COPY)
+  {
+    value->kind = TOML_STRING_VIEW;
+    value->view = view;
+    return TOML_E_OK;
+  }
+  value->kind = TOML_STRING;
+  value->string = string;
+  return string != NULL ? TOML_E_OK :
+         make_string(ctx, view.data, view.len, &(value->string));
 }
 
 /*
@@ -131,23 +149,31 @@ void TOMLValue_destroy(TOMLValue *val)
   } else if (val->kind == TOML_ARRAY || val->kind == TOML_TABLE_ARRAY)
   {
     TOMLArray_destroy(val->array);
+  } else if (val->kind == TOML_PACKED_ARRAY)
+  {
+    TOMLPackedArray_destroy(val->packed);
   } else if (val->kind == TOML_TABLE || val->kind == TOML_INLINE_TABLE)
   {
     TOMLTable_destroy(val->table);
   }
 }
 
-/**
- * @brief Calls @link TOMLValue_destroy @endlink on all the items and frees
- *        the array.
- */
-void TOMLArray_destroy(TOMLArray array)
+TOMLStringView TOMLValue_string(TOMLValue const *val)
 {
-  for (int i = 0, len = TOMLArray_len(array); i < len; ++(i))
+  if (val->kind == TOML_STRING_VIEW)
+  {
+    return val->view;
+  } else if (val->kind == TOML_SHORT_STRING)
   {
-    TOMLValue_destroy(&(array[i]));
+    return (TOMLStringView) {
+      .data = val->short_string,
+      .len = TOML_SHORT_STRING_MAX - val->short_string[TOML_SHORT_STRING_MAX]
+    };
   }
-  TOMLArray_cleanup(array);
+  return (TOMLStringView) {
+    .data = val->string,
+    .len = val->string == NULL ? 0 : String_len(val->string)
+  };
 }
 
 /**
@@ -226,6 +252,16 @@ void TOMLValue_print(TOMLValue const *value, int level)
     SIMPLE(STRING,
            ANSIQ_SETFG_GREEN "\"%.*s\"" ANSIQ_GR_RESET,
            String_len(value->string), value->string);
+    SIMPLE(STRING_VIEW,
+           ANSIQ_SETFG_GREEN "\"%.*s\"" ANSIQ_GR_RESET,
+           value->view.len, value->view.data);
+    SIMPLE(SHORT_STRING,
+           ANSIQ_SETFG_GREEN "\"%s\"" ANSIQ_GR_RESET,
+           value->short_string);
+    KIND(LAZY)
+    {
+      fputs("...", stdout);
+    } break;
     KIND(DATETIME)
     {
       print_date(&(value->datetime.date));
@@ -254,12 +290,28 @@ void TOMLValue_print(TOMLValue const *value, int level)
       for (int i = 0; i < outer_space_count; ++(i), putchar(' '));
       putchar(']');
     } break;
+    KIND(PACKED_ARRAY)
+    {
+      int const len = TOMLPackedArray_len(value->packed);
+      puts("[");
+      for (int i = 0; i < len; ++(i))
+      {
+        TOMLValue item;
+        TOMLPackedArray_get(value->packed, i, &(item));
+        for (int j = 0; j < inner_space_count; ++(j), putchar(' '));
+        TOMLValue_print(&(item), level + 1);
+        puts(i < len - 1 ? "," : "");
+      }
+      for (int i = 0; i < outer_space_count; ++(i), putchar(' '));
+      putchar(']');
+    } break;
     KIND(TABLE)
     KIND(INLINE_TABLE)
     {
       TOMLTable_Bucket const *current = &(value->table[0]);
       TOMLTable_Bucket const *const end = current +
-                                          TOMLTable_size(value->table);
+                                          TOMLTable_len(value->table);
+      int printed = 0;
       puts("{");
       for (; current < end; ++(current))
       {
@@ -271,10 +323,12 @@ void TOMLValue_print(TOMLValue const *value, int level)
           }
           printf(
               ANSIQ_SETFG_CYAN "%.*s" ANSIQ_GR_RESET " = ",
-              String_len(current->key), current->key
+              current->key_len, current->key
+          );
+          TOMLValue_print(
+              TOMLTable_value(value->table, current - value->table), level + 1
           );
-          TOMLValue_print(&(current->value), level + 1);
-          puts(current < end - 1 ? "," : "");
+          puts(++(printed) < TOMLTable_count(value->table) ? "," : "");
         }
       }
       for (int i = 0; i < outer_space_count; ++(i))
@@ -302,7 +356,9 @@ void TOMLValue_print(TOMLValue const *value, int level)
  * @returns @link TOML_E_INVALID_NUMBER @endlink when trying to parse an
  *          invalid numerical value,
  *          @link TOML_E_INT_OVERFLOW @endlink when trying to parse an integer
- *          that is too big.
+ *          that is too big,
+ *          @link TOML_E_FLOAT_OVERFLOW @endlink when a float is too big to be
+ *          represented by a double.
  */
 TOMLStatus TOML_parse_number(TOMLCtx *ctx, TOMLValue *value)
 {
@@ -343,28 +399,22 @@ TOMLStatus TOML_parse_number(TOMLCtx *ctx, TOMLValue *value)
         ++(OFFSET);
         base = 2;
       } break;
-      CASE('\n')
-      CASE('\t')
-      CASE(' ')
-      CASE('\0')
-      CASE('#')
+      CASE('0'...'9')
+      CASE('_')
       {
-        value->kind = TOML_INTEGER;
-        value->integer = 0;
-        // we just jump at the end
-        throw(OK);
+        // Leading zeroes aren't allowed
+        throw(INVALID_NUMBER);
       }
       default:
       {
-        // XXX: remove this if we do the check in every function that calls
-        //      this function
-        throw(INVALID_NUMBER);
-      }
+        // A plain zero, or the integer part of a float like `0.5` or `0e3`
+        --(OFFSET);
+      } break;
     }
   } else if (OFFSET[0] == 'i' && OFFSET[1] == 'n' && OFFSET[2] == 'f')
   {
     value->kind = TOML_FLOAT;
-    value->float_ = __builtin_inff();
+    value->float_ = neg ? -__builtin_inf() : __builtin_inf();
     OFFSET += 3;
     throw(OK);
   } else if (OFFSET[0] == 'n' && OFFSET[1] == 'a' && OFFSET[2] == 'n')
@@ -374,76 +424,30 @@ TOMLStatus TOML_parse_number(TOMLCtx *ctx, TOMLValue *value)
     OFFSET += 3;
     throw(OK);
   }
-  try(
-      parse_int(
-        &(OFFSET), end, base, neg ? PARSE_INT_NEG : 0, &(value->integer)
-      )
+  char const *const digits = OFFSET;
+  status = TOML_parse_int(
+      &(OFFSET), end, base, neg ? PARSE_INT_NEG : 0, &(value->integer)
   );
   if (
       base == 10
-      && OFFSET < ctx->end
-      && *OFFSET == '.'
-      && is_digit(OFFSET[1])
+      && OFFSET < end
+      && (
+        (*OFFSET == '.' && OFFSET + 1 < end && is_digit(OFFSET[1]))
+        || *OFFSET == 'e'
+        || *OFFSET == 'E'
+      )
   )
   {
-    ++(OFFSET);
-    double float_ = (double)value->integer;
-    signed long frac_int = 0;
-    char const *offset = OFFSET;
-    try(
-        parse_int(
-          &(OFFSET),
-          end,
-          10,
-          (neg ? PARSE_INT_NEG : 0)|PARSE_INT_ILZ,
-          &(frac_int)
-        )
-    );
-    double frac = (double)frac_int;
-    for (int i = 0, frac_len = OFFSET - offset; i < frac_len; ++i)
-    {
-      frac /= 10;
-    }
-    value->float_ = float_ + frac;
+    // The integer part is parsed again along with the rest, since the
+    // rounding depends on all of the digits.
+    OFFSET = digits;
     value->kind = TOML_FLOAT;
+    status = TOML_parse_float(&(OFFSET), end, neg, &(value->float_));
   } else
   {
+    throw_if(base != 10 && OFFSET == digits, INVALID_NUMBER);
     value->kind = TOML_INTEGER;
   }
-  if (
-      OFFSET < ctx->end
-      && base == 10
-      && (*OFFSET == 'e' || *OFFSET == 'E')
-  )
-  {
-    ++(OFFSET);
-    if (value->kind == TOML_INTEGER)
-    {
-      value->float_ = (double)value->integer;
-    }
-    switch (*OFFSET)
-    {
-      CASE('-')
-      {
-        neg = 1;
-      } __fallthrough__;
-      CASE('+')
-      {
-        ++(OFFSET);
-      }
-    }
-    int neg_exp = 0;
-    signed long e = 0;
-    try(parse_int(&(OFFSET), ctx->end, 10, 0, &(e)));
-    double float_ = (value->kind == TOML_INTEGER ?
-                    (double)value->integer :
-                    value->float_);
-    for (int i = 0; i < e; ++(i))
-    {
-      float_ = (neg_exp ? (float_ / 10) : (float_ * 10));
-    }
-    value->float_ = float_;
-  }
 
 catch:
   return status;
@@ -476,7 +480,7 @@ catch:
         INVALID_HEX_ESCAPE                                    \
     );                                                        \
     signed long charcode = 0;                                 \
-    parse_int(&(offset), offset + 2, 16, 0, &(charcode));     \
+    TOML_parse_int(&(offset), offset + 2, 16, 0, &(charcode));\
     chr = (char)charcode;                                     \
     --(offset);                                               \
     break;                                                    \
@@ -496,116 +500,176 @@ catch:
     break;                                                    \
   }
 
-/**
- * @brief Parses a single-line string.
- * @param string The address where the parsed string will be stored.
+/*
+ * @brief Finds the closing delimiter of the string at the cursor.
+ * @param escaped_p Set to whether the string has escape sequences.
+ * @returns The address of the closing delimiter, `NULL` if the string is not
+ *          terminated.
  */
-TOMLStatus TOML_parse_sl_string(TOMLCtx *ctx, String *string)
+static char const *string_end(TOMLCtx *ctx, int multiline, int *escaped_p)
 {
-  TOMLStatus status = TOML_E_OK;
-  char const *offset = OFFSET;
+  char const quote = *OFFSET;
+  char const stop = quote == '"' ? '\\' : quote;
+  char const *offset = OFFSET + (multiline ? 3 : 1);
   char const *const end = ctx->end;
-
-  char quote = *(offset++);
-
-  StringBuffer buffer = StringBuffer_with_capacity(8);
-  throw_if(buffer == NULL, OOM);
-
-  for (char chr; offset < end; ++(offset))
+  *escaped_p = 0;
+  for (;;)
   {
-    chr = *offset;
-    throw_if(chr == '\n', UNTERMINATED_STRING);
-    if (chr == '\\' && quote == '"')
+    offset = TOML_scan_string(offset, end, quote, stop);
+    if (offset >= end)
+    {
+      return NULL;
+    }
+    char const chr = *offset;
+    if (chr == quote)
     {
-      ++offset;
-      switch (*(offset))
+      if (!multiline ||
+          (offset + 2 < end && offset[1] == quote && offset[2] == quote))
       {
-        HANDLE_ESCAPE_CASES(chr, offset);
+        return offset;
       }
-    } else if (chr == quote)
+      ++(offset);
+    } else if (chr == '\\')
     {
-      break;
+      *escaped_p = 1;
+      offset += 2;
+    } else if (chr == '\n' && !multiline)
+    {
+      return NULL;
+    } else
+    {
+      ++(offset);
     }
-    throw_if(StringBuffer_push(&buffer, chr) != 0, OOM);
   }
+}
 
-  throw_if(*offset != quote, UNTERMINATED_STRING);
-  ++offset;
-  *string = StringBuffer_transform_to_string(&buffer);
-
-catch:
-  if (status != TOML_E_OK && buffer != NULL)
+/*
+ * @brief Copies the body of a basic string to `dst`, processing its escape
+ *        sequences. `dst` needs room for `end - src` bytes.
+ * @param len_p Set to the number of bytes written to `dst`.
+ */
+static TOMLStatus unescape(char const *src, char const *const end, char *dst,
+                           int multiline, int *len_p)
+{
+  TOMLStatus status = TOML_E_OK;
+  char *out = dst;
+  while (src < end)
   {
-    StringBuffer_cleanup(buffer);
+    // Clean runs are copied in bulk.
+    char const *run = TOML_scan_string(src, end, '\\', '\\');
+    memcpy(out, src, run - src);
+    out += run - src;
+    src = run;
+    if (src == end)
+    {
+      break;
+    } else if (*src != '\\')
+    {
+      *(out++) = *(src++);
+      continue;
+    }
+    char chr = '\\';
+    ++(src);
+    if (multiline && (*src == ' ' || *src == '\n'))
+    {
+      for (; src < end && (*src == ' ' || *src == '\n'); ++(src)) {}
+      continue;
+    }
+    switch (*src)
+    {
+      HANDLE_ESCAPE_CASES(chr, src);
+    }
+    *(out++) = chr;
+    ++(src);
   }
-  OFFSET = offset;
+
+catch:
+  *len_p = out - dst;
   return status;
 }
 
-/**
- * @brief Parses a multi-line string.
- * @param string The address where the parsed string will be stored.
+/*
+ * @brief Makes a string out of the body of a string between `start` and
+ *        `str_end`.
+ * @param string Set to the parsed string, or to `NULL` if it was borrowed.
+ * @param view If not `NULL`, the string is borrowed from the content and
+ *             `view` set to it whenever it needs no escape processing.
  */
-TOMLStatus TOML_parse_ml_string(TOMLCtx *ctx, String *string)
+static TOMLStatus string_body(TOMLCtx *ctx, char const *start,
+                              char const *str_end, int multiline, int escaped,
+                              String *string, TOMLStringView *view)
 {
   TOMLStatus status = TOML_E_OK;
-  char const *offset = OFFSET;
-  char const quote = *offset;
-  offset += 3;
-
-  char quotes[] = {quote, quote, quote, 0};
-  char const *str_end = strstr(offset, quotes);
-  StringBuffer buffer = NULL;
-  throw_if(str_end == NULL, UNTERMINATED_STRING);
-  int len = str_end - offset;
-
-  buffer = StringBuffer_with_capacity(len + 1);
-  throw_if(buffer == NULL, OOM);
-
-  int trimming = 0;
-  for (char chr; offset < str_end; ++(offset))
+  *string = NULL;
+  if (!escaped && view != NULL)
+  {
+    view->data = start;
+    view->len = str_end - start;
+  } else if (!escaped)
+  {
+    try(make_string(ctx, start, str_end - start, string));
+  } else
   {
-    chr = *offset;
-    if (trimming)
+    // The unescaped string is never longer than the source.
+    char small[256];
+    int len = str_end - start;
+    char *dst = len <= (int)sizeof(small) ? small : malloc(len);
+    throw_if(dst == NULL, OOM);
+    status = unescape(start, str_end, dst, multiline, &len);
+    if (status == TOML_E_OK)
     {
-      if (chr == ' ' || chr == '\n')
-      {
-        continue;
-      } else
-      {
-        trimming = 0;
-      }
+      status = make_string(ctx, dst, len, string);
     }
-    if (chr == '\\' && quote == '"')
+    if (dst != small)
     {
-      switch (*(++(offset)))
-      {
-        HANDLE_ESCAPE_CASES(chr, offset);
-        CASE(' ')
-        CASE('\n')
-        {
-          trimming = 1;
-          goto skip_buffering;
-        }
-      }
+      free(dst);
     }
-    throw_if(StringBuffer_push(&buffer, chr) != 0, OOM);
-
-skip_buffering:;
   }
 
-  offset += 3;
-  *string = StringBuffer_transform_to_string(&buffer);
+catch:
+  return status;
+}
+
+/*
+ * @brief Parses the string at the cursor.
+ * @param string Set to the parsed string, or to `NULL` if it was borrowed.
+ * @param view If not `NULL`, the string is borrowed from the content and
+ *             `view` set to it whenever it needs no escape processing.
+ */
+static TOMLStatus parse_string(TOMLCtx *ctx, int multiline, String *string,
+                               TOMLStringView *view)
+{
+  TOMLStatus status = TOML_E_OK;
+  int escaped = 0;
+  int const delim_len = multiline ? 3 : 1;
+  char const *const str_end = string_end(ctx, multiline, &escaped);
+  throw_if(str_end == NULL, UNTERMINATED_STRING);
+  try(string_body(ctx, OFFSET + delim_len, str_end, multiline, escaped,
+                  string, view));
+  OFFSET = str_end + delim_len;
 
 catch:
-  if (status != TOML_E_OK && buffer != NULL)
-  {
-    StringBuffer_cleanup(buffer);
-  }
-  OFFSET = offset;
   return status;
 }
 
+/**
+ * @brief Parses a single-line string.
+ * @param string The address where the parsed string will be stored.
+ */
+TOMLStatus TOML_parse_sl_string(TOMLCtx *ctx, String *string)
+{
+  return parse_string(ctx, 0, string, NULL);
+}
+
+/**
+ * @brief Parses a multi-line string.
+ * @param string The address where the parsed string will be stored.
+ */
+TOMLStatus TOML_parse_ml_string(TOMLCtx *ctx, String *string)
+{
+  return parse_string(ctx, 1, string, NULL);
+}
+
 #undef HANDLE_ESCAPE_CASES
 
 /**
@@ -624,17 +688,17 @@ TOMLStatus TOML_parse_time(TOMLCtx *ctx, TOMLTime *time)
   );
   char const *old_offset = OFFSET;
 
-  parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
+  TOML_parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
   register int const hour = (int)parsed_num;
   throw_if(old_offset + 2 != OFFSET, INVALID_TIME);
   ++(OFFSET);
 
-  parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
+  TOML_parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
   register int const min = (int)parsed_num;
   throw_if(old_offset + 5 != OFFSET, INVALID_TIME);
   ++(OFFSET);
 
-  parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
+  TOML_parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
   register int const sec = (int)parsed_num;
   throw_if(old_offset + 8 != OFFSET, INVALID_TIME);
 
@@ -643,7 +707,7 @@ TOMLStatus TOML_parse_time(TOMLCtx *ctx, TOMLTime *time)
   if (*OFFSET == '.')
   {
     ++(OFFSET);
-    parse_int(&(OFFSET), OFFSET + 5, 10, PARSE_INT_ILZ, &(parsed_num));
+    TOML_parse_int(&(OFFSET), OFFSET + 5, 10, PARSE_INT_ILZ, &(parsed_num));
     millisec = (int)parsed_num;
   }
   switch (*OFFSET)
@@ -661,13 +725,13 @@ TOMLStatus TOML_parse_time(TOMLCtx *ctx, TOMLTime *time)
       // we put the one we have in buffer
       z[0] = *((OFFSET)++);
       try_cond(OFFSET + 2 <= end, INVALID_TIME);
-      parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
+      TOML_parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
       z[1] = (uint8_t)parsed_num;
       if (OFFSET < end && *OFFSET == ':')
       {
         ++(OFFSET);
         try_cond(OFFSET + 2 <= end, INVALID_TIME);
-        parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
+        TOML_parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
         z[2] = (uint8_t)parsed_num;
       }
     } break;
@@ -698,17 +762,17 @@ TOMLStatus TOML_parse_datetime(TOMLCtx *ctx, TOMLValue *value)
       OFFSET + 10 <= end && OFFSET[4] == '-' && OFFSET[7] == '-', INVALID_DATE
   );
   char const *old_offset = OFFSET;
-  parse_int(&(OFFSET), OFFSET + 4, 10, 0, &(parsed_num));
+  TOML_parse_int(&(OFFSET), OFFSET + 4, 10, 0, &(parsed_num));
   register int const year = (int)parsed_num;
   throw_if(old_offset + 4 != OFFSET, INVALID_DATE);
   ++(OFFSET);
 
-  parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
+  TOML_parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
   register int const month = (int)parsed_num;
   throw_if(old_offset + 7 != OFFSET, INVALID_DATE);
   ++(OFFSET);
 
-  parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
+  TOML_parse_int(&(OFFSET), OFFSET + 2, 10, PARSE_INT_ILZ, &(parsed_num));
   register int const day = (int)parsed_num;
 
   char const current = *OFFSET;
@@ -732,75 +796,219 @@ catch:
   return status;
 }
 
-/**
- * @brief Parses a TOML array value.
- * @param array The address where the parsed array will be stored.
+/*
+ * @brief Frees a value that didn't make it into the document, unless it's
+ *        owned by the context's arena.
  */
-TOMLStatus TOML_parse_array(TOMLCtx *ctx, TOMLArray *array)
+static void drop_value(TOMLCtx *ctx, TOMLValue *value)
+{
+  if (ctx->arena == NULL)
+  {
+    TOMLValue_destroy(value);
+  }
+}
+
+/*
+ * @brief Starts the array of `value`, a packed one if `pack` is set, which
+ *        is only made once the kind of its first item is known.
+ */
+static TOMLStatus array_begin(TOMLCtx *ctx, TOMLValue *value, int pack)
+{
+  if (pack)
+  {
+    value->kind = TOML_PACKED_ARRAY;
+    value->packed = NULL;
+    return TOML_E_OK;
+  }
+  value->kind = TOML_ARRAY;
+  value->array = TOMLArray_new_in(ctx->arena);
+  return value->array == NULL ? TOML_E_OOM : TOML_E_OK;
+}
+
+/*
+ * @brief Turns the packed array of `value` into a regular one, copying its
+ *        strings.
+ */
+static TOMLStatus unpack_array(TOMLCtx *ctx, TOMLValue *value)
 {
   TOMLStatus status = TOML_E_OK;
-  char const *const end = ctx->end;
-  TOMLArray vec = TOMLArray_new();
+  TOMLPackedArray const packed = value->packed;
+  int const len = packed == NULL ? 0 : TOMLPackedArray_len(packed);
+  TOMLArray vec = TOMLArray_with_capacity_in(len, ctx->arena);
   throw_if(vec == NULL, OOM);
-  ++(OFFSET);
-
-  for (int expect_value = 1; OFFSET < end; )
+  for (int i = 0; i < len; ++(i))
   {
-    char const chr = *OFFSET;
-    if (chr == ']')
-    {
-      break;
-    } else if (chr == ' ' || chr == '\n' || chr == '\t')
-    {
-      ++(OFFSET);
-    } else if (chr == '#')
-    {
-      char const *nl = strchr(OFFSET, '\n');
-      throw_if(nl == NULL, ARRAY);
-      OFFSET = nl + 1;
-    } else if (chr == ',')
-    {
-      throw_if(expect_value, UNEXPECTED_CHAR);
-      ++(OFFSET);
-      expect_value = 1;
-    } else
+    TOMLValue *val_p = TOMLArray_push_empty(&(vec));
+    TOMLPackedArray_get(packed, i, val_p);
+    if (val_p->kind == TOML_STRING_VIEW)
     {
-      throw_if(!expect_value, COMMA_OR_BRACKET);
-      TOMLValue *val_p = TOMLArray_push_empty(&(vec));
-      try(TOML_parse_value(ctx, val_p));
-      expect_value = 0;
+      TOMLStringView const view = val_p->view;
+      val_p->kind = 0;
+      try(make_string(ctx, view.data, view.len, &(val_p->string)));
+      val_p->kind = TOML_STRING;
     }
   }
-
-  throw_if(*OFFSET != ']', ARRAY);
-  ++(OFFSET);
-  *array = vec;
+  TOMLPackedArray_destroy(packed);
+  value->kind = TOML_ARRAY;
+  value->array = vec;
 
 catch:
-  if (status != TOML_E_OK && array != NULL)
+  if (status != TOML_E_OK && vec != NULL)
   {
     TOMLArray_destroy(vec);
   }
   return status;
 }
 
-/**
- * @brief Parses a TOML value.
- * @param value The address to the @link TOMLValue @endlink struct where the
- *              data parsed will be stored. The `kind` field will be set
- *              according to the content provided for parsing.
+/*
+ * @brief Where the next item of the array of `value` is parsed: at its end
+ *        if it's a regular array, in `item` if it's a packed one.
  */
-TOMLStatus TOML_parse_value(TOMLCtx *ctx, TOMLValue *value)
+static TOMLValue *array_slot(TOMLValue *value, TOMLValue *item)
 {
-  TOMLStatus status = TOML_E_OK;
-  char current = *OFFSET;
-  switch (current)
+  if (value->kind == TOML_ARRAY)
   {
-    CASE(' ')
-    CASE('\t')
-    {
-      ++(OFFSET);
-      return TOML_parse_value(ctx, value);
+    return TOMLArray_push_empty(&(value->array));
+  }
+  memset(item, '\0', sizeof(TOMLValue));
+  return item;
+}
+
+/*
+ * @brief Adds the item parsed in `item` to the packed array of `value`, or
+ *        unpacks the array if the item can't go in it.
+ *
+ * The kind of `item` is cleared once the array owns what it had, so it's
+ * left for the caller to drop otherwise.
+ */
+static TOMLStatus array_add(TOMLCtx *ctx, TOMLValue *value, TOMLValue *item)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLKind const kind = TOMLPackedArray_kind_of(item->kind);
+  if (value->packed == NULL && kind != 0)
+  {
+    value->packed = TOMLPackedArray_new_in(kind, ctx->arena);
+    throw_if(value->packed == NULL, OOM);
+  }
+  if (value->packed != NULL && TOMLPackedArray_kind(value->packed) == kind)
+  {
+    throw_if(TOMLPackedArray_push(value->packed, item) != 0, OOM);
+    drop_value(ctx, item);
+  } else
+  {
+    try(unpack_array(ctx, value));
+    TOMLValue *val_p = TOMLArray_push_empty(&(value->array));
+    throw_if(val_p == NULL, OOM);
+    *val_p = *item;
+  }
+  item->kind = 0;
+
+catch:
+  return status;
+}
+
+/*
+ * @brief Finishes the array of `value`, which is left a regular one if it
+ *        was going to be packed but has no items.
+ */
+static TOMLStatus array_end(TOMLCtx *ctx, TOMLValue *value)
+{
+  return value->kind == TOML_PACKED_ARRAY && value->packed == NULL ?
+         unpack_array(ctx, value) : TOML_E_OK;
+}
+
+/*
+ * @brief Parses the array at the cursor into `value`.
+ * @param pack Whether to make a @link TOML_PACKED_ARRAY @endlink if the
+ *             items are all integers, floats, booleans or strings.
+ */
+static TOMLStatus parse_array(TOMLCtx *ctx, TOMLValue *value, int pack)
+{
+  TOMLStatus status = TOML_E_OK;
+  char const *const end = ctx->end;
+  TOMLValue item = { .kind = 0 };
+  try(array_begin(ctx, value, pack));
+  ++(OFFSET);
+
+  for (int expect_value = 1; OFFSET < end; )
+  {
+    char const chr = *OFFSET;
+    if (chr == ']')
+    {
+      break;
+    } else if (chr == ' ' || chr == '\n' || chr == '\t')
+    {
+      ++(OFFSET);
+    } else if (chr == '#')
+    {
+      char const *nl = strchr(OFFSET, '\n');
+      throw_if(nl == NULL, ARRAY);
+      OFFSET = nl + 1;
+    } else if (chr == ',')
+    {
+      throw_if(expect_value, UNEXPECTED_CHAR);
+      ++(OFFSET);
+      expect_value = 1;
+    } else
+    {
+      throw_if(!expect_value, COMMA_OR_BRACKET);
+      TOMLValue *val_p = array_slot(value, &(item));
+      throw_if(val_p == NULL, OOM);
+      try(TOML_parse_value(ctx, val_p));
+      if (val_p == &(item))
+      {
+        try(array_add(ctx, value, &(item)));
+      }
+      expect_value = 0;
+    }
+  }
+
+  throw_if(*OFFSET != ']', ARRAY);
+  ++(OFFSET);
+  try(array_end(ctx, value));
+
+catch:
+  if (status != TOML_E_OK)
+  {
+    drop_value(ctx, &(item));
+    TOMLValue_destroy(value);
+    value->array = NULL;
+  }
+  return status;
+}
+
+/**
+ * @brief Parses a TOML array value, which is never packed.
+ * @param array The address where the parsed array will be stored.
+ */
+TOMLStatus TOML_parse_array(TOMLCtx *ctx, TOMLArray *array)
+{
+  TOMLValue value;
+  TOMLStatus const status = parse_array(ctx, &(value), 0);
+  if (status == TOML_E_OK)
+  {
+    *array = value.array;
+  }
+  return status;
+}
+
+/**
+ * @brief Parses a TOML value.
+ * @param value The address to the @link TOMLValue @endlink struct where the
+ *              data parsed will be stored. The `kind` field will be set
+ *              according to the content provided for parsing.
+ */
+TOMLStatus TOML_parse_value(TOMLCtx *ctx, TOMLValue *value)
+{
+  TOMLStatus status = TOML_E_OK;
+  char current = *OFFSET;
+  switch (current)
+  {
+    CASE(' ')
+    CASE('\t')
+    {
+      ++(OFFSET);
+      return TOML_parse_value(ctx, value);
     }
     CASE('0'...'9')
     {
@@ -826,20 +1034,23 @@ number:
     CASE('"')
     CASE('\'')
     {
+      String string = NULL;
+      TOMLStringView view;
       value->string = NULL;
       value->kind = TOML_STRING;
-      if (OFFSET[1] == current && OFFSET[2] == current)
-      {
-        return TOML_parse_ml_string(ctx, &(value->string));
-      } else
-      {
-        return TOML_parse_sl_string(ctx, &(value->string));
-      }
-    }
+      try(
+          parse_string(
+            ctx,
+            OFFSET[1] == current && OFFSET[2] == current,
+            &(string),
+            borrow_strings(ctx) ? &(view) : NULL
+          )
+      );
+      try(set_string(ctx, value, string, view));
+    } break;
     CASE('[')
     {
-      value->kind = TOML_ARRAY;
-      return TOML_parse_array(ctx, &(value->array));
+      return parse_array(ctx, value, ctx->flags & TOML_F_PACK_ARRAYS);
     }
     CASE('f')
     {
@@ -875,7 +1086,7 @@ number:
     CASE('{')
     {
       value->kind = TOML_INLINE_TABLE;
-      value->table = TOMLTable_new();
+      value->table = TOMLTable_new_in(ctx->arena);
       return TOML_parse_inline_table(ctx, &(value->table));
     }
     default:
@@ -888,33 +1099,67 @@ catch:
   return status;
 }
 
-static TOMLStatus parse_key(TOMLCtx *ctx, String *key)
+/*
+ * @brief Parses a bare or quoted key.
+ * @param key Set to the parsed key if it had to be copied, `NULL` if it was
+ *            borrowed from the content, which happens with zero-copy or when
+ *            the keys are interned.
+ * @param view Set to the contents of the key in both cases.
+ */
+static TOMLStatus parse_key(TOMLCtx *ctx, String *key, TOMLStringView *view)
 {
+  TOMLStatus status = TOML_E_OK;
+  int const borrow = ctx->flags & TOML_F_ZERO_COPY || ctx->keys != NULL;
   char c = *OFFSET;
+  *key = NULL;
   if (c == '\'' || c == '"')
   {
-    if (OFFSET[1] == c && OFFSET[2] == c)
-    {
-      return TOML_parse_ml_string(ctx, key);
-    } else
+    status = parse_string(ctx, OFFSET[1] == c && OFFSET[2] == c, key,
+                          borrow ? view : NULL);
+    if (status == TOML_E_OK && *key != NULL)
     {
-      return TOML_parse_sl_string(ctx, key);
+      *view = (TOMLStringView) { .data = *key, .len = String_len(*key) };
     }
+    return status;
   } else
   {
-    *key = (String)StringBuffer_new();
     char const *offset = OFFSET;
     char const *const end = ctx->end;
     for (; (offset < end) &&
            (is_letter(c) || is_digit(c) || c == '_' || c == '-'); )
     {
-      StringBuffer_push((StringBuffer *)key, c);
       c = *(++(offset));
     }
+    view->data = OFFSET;
+    view->len = offset - OFFSET;
     OFFSET = offset;
-    StringBuffer_transform_to_string((StringBuffer *)key);
-    return TOML_E_OK;
+    if (borrow)
+    {
+      return TOML_E_OK;
+    }
+    status = make_string(ctx, view->data, view->len, key);
+    view->data = *key;
+    return status;
+  }
+}
+
+/*
+ * @brief Puts a key returned by `parse_key` in the table, borrowing it if it
+ *        wasn't copied. An interned key is borrowed from the interner and
+ *        the copy, if any, is dropped and `*key_p` cleared.
+ */
+static TOMLValue *put_key(TOMLCtx *ctx, TOMLTable *table_p, String *key_p,
+                          TOMLStringView view)
+{
+  if (ctx->keys != NULL)
+  {
+    TOMLKey const *key = TOMLInterner_intern(ctx->keys, view.data, view.len);
+    drop_string(ctx, *key_p);
+    *key_p = NULL;
+    return key == NULL ? NULL : TOMLTable_put_key(table_p, key);
   }
+  return *key_p != NULL ? TOMLTable_put(table_p, *key_p) :
+                          TOMLTable_put_view(table_p, view);
 }
 
 /**
@@ -929,11 +1174,12 @@ TOMLStatus TOML_parse_entry(TOMLCtx *ctx, TOMLTable *table_p)
   char const *offset = OFFSET;
 
   String key = NULL;
+  TOMLStringView key_view = {0};
   for (; offset <= end; OFFSET = offset)
   {
-    try(parse_key(ctx, &key));
+    try(parse_key(ctx, &key, &key_view));
     offset = OFFSET;
-    TOMLValue *val_p = TOMLTable_put(table_p, key);
+    TOMLValue *val_p = put_key(ctx, table_p, &(key), key_view);
     for (int running = 1; running; )
     {
       OFFSET = offset;
@@ -943,11 +1189,11 @@ TOMLStatus TOML_parse_entry(TOMLCtx *ctx, TOMLTable *table_p)
         if (val_p->kind == 0)
         {
           val_p->kind = TOML_TABLE;
-          val_p->table = TOMLTable_new();
+          val_p->table = TOMLTable_new_in(ctx->arena);
         } else
         {
           throw_if(val_p->kind != TOML_TABLE, EXPECTED_TABLE);
-          String_cleanup(key);
+          drop_string(ctx, key);
           key = NULL;
         }
         table_p = &(val_p->table);
@@ -974,7 +1220,7 @@ catch:
   {
     if (key != NULL)
     {
-      String_cleanup(key);
+      drop_string(ctx, key);
     }
   }
   OFFSET = offset;
@@ -1045,20 +1291,21 @@ TOMLStatus TOML_parse_table_header(TOMLCtx *ctx, TOMLTable *table_p,
 {
   TOMLStatus status = TOML_E_OK;
   String key = NULL;
+  TOMLStringView key_view = {0};
   for (; OFFSET < ctx->end && *OFFSET != ']'; )
   {
-    try(parse_key(ctx, &(key)));
+    try(parse_key(ctx, &(key), &(key_view)));
     if (*OFFSET == '.')
     {
       ++(OFFSET);
-      TOMLValue *val_p = TOMLTable_put(table_p, key);
+      TOMLValue *val_p = put_key(ctx, table_p, &(key), key_view);
       if (val_p->kind == 0)
       {
         val_p->kind = TOML_TABLE;
-        val_p->table = TOMLTable_new();
+        val_p->table = TOMLTable_new_in(ctx->arena);
       } else
       {
-        String_cleanup(key);
+        drop_string(ctx, key);
         key = NULL;
         throw_if(val_p->kind != TOML_TABLE, EXPECTED_TABLE);
       }
@@ -1078,33 +1325,33 @@ TOMLStatus TOML_parse_table_header(TOMLCtx *ctx, TOMLTable *table_p,
   {
     throw_if(!is_tblarr, TABLE_ARRAY_HEADER);
     ++(OFFSET);
-    TOMLValue *arrval_p = TOMLTable_put(table_p, key);
+    TOMLValue *arrval_p = put_key(ctx, table_p, &(key), key_view);
     TOMLValue *tblval_p = NULL;
     if (arrval_p->kind != 0)
     {
-      String_cleanup(key);
+      drop_string(ctx, key);
       throw_if(arrval_p->kind != TOML_TABLE_ARRAY, EXPECTED_TABLE_ARRAY);
     } else
     {
       arrval_p->kind = TOML_TABLE_ARRAY;
-      arrval_p->array = TOMLArray_new();
+      arrval_p->array = TOMLArray_new_in(ctx->arena);
     }
     tblval_p = TOMLArray_push_empty(&(arrval_p->array));
     tblval_p->kind = TOML_TABLE;
-    tblval_p->table = TOMLTable_new();
+    tblval_p->table = TOMLTable_new_in(ctx->arena);
     *out_pp = &(tblval_p->table);
   } else
   {
     throw_if(is_tblarr, TABLE_HEADER);
-    TOMLValue *tblval_p = TOMLTable_put(table_p, key);
+    TOMLValue *tblval_p = put_key(ctx, table_p, &(key), key_view);
     if (tblval_p->kind != 0)
     {
-      String_cleanup(key);
+      drop_string(ctx, key);
       throw_if(tblval_p->kind != TOML_TABLE, EXPECTED_TABLE);
     } else
     {
       tblval_p->kind = TOML_TABLE;
-      tblval_p->table = TOMLTable_new();
+      tblval_p->table = TOMLTable_new_in(ctx->arena);
     }
     *out_pp = &(tblval_p->table);
   }
@@ -1166,3 +1413,822 @@ TOMLStatus TOML_parse(TOMLCtx *ctx, TOMLTable *table_p)
 catch:
   return status;
 }
+
+/*
+ * @brief The second stage of the two-stage parser walks a @link TOMLTape
+ *        @endlink. The cursor of the context is kept at the first byte that
+ *        wasn't consumed, and `i` at the first token that wasn't.
+ */
+typedef struct TapeWalk {
+  TOMLCtx        *ctx;
+  TOMLTape const *tape;
+  int             i;
+  int             lazy; ///< Whether the values of entries are only skipped
+                        ///< over, see @link TOMLDoc @endlink.
+} TapeWalk;
+
+static TOMLStatus tape_value(TapeWalk *, TOMLValue *);
+
+/*
+ * @brief The address of the next token, `ctx->end` if there are no more.
+ */
+__inline__
+char const *tape_token(TapeWalk const *w)
+{
+  return w->i < w->tape->len ?
+         w->tape->base + TOML_TAPE_OFFSET(w->tape->items[w->i]) :
+         w->ctx->end;
+}
+
+/*
+ * @brief Skips blanks and comments, and newlines too if `newlines` is set.
+ * @returns The token at the cursor, or `0` if the cursor is at text or at
+ *          the end.
+ */
+static char tape_skip(TapeWalk *w, int newlines)
+{
+  TOMLCtx *const ctx = w->ctx;
+  for (;;)
+  {
+    for (; *OFFSET == ' ' || *OFFSET == '\t' || *OFFSET == '\r'; ++(OFFSET))
+    {
+    }
+    if (OFFSET >= ctx->end || OFFSET != tape_token(w))
+    {
+      return 0;
+    } else if (*OFFSET == '#')
+    {
+      // The comment runs up to the newline, which is the next token.
+      ++(w->i);
+      OFFSET = tape_token(w);
+    } else if (*OFFSET == '\n' && newlines)
+    {
+      ++(w->i);
+      ++(OFFSET);
+    } else
+    {
+      return *OFFSET;
+    }
+  }
+}
+
+/*
+ * @brief Consumes the token at the cursor.
+ */
+__inline__
+void tape_next(TapeWalk *w)
+{
+  ++(w->i);
+  ++(w->ctx->offset);
+}
+
+/*
+ * @brief Makes a string out of the quotes at the cursor and the token after
+ *        them, which is their closing counterpart.
+ * @param view If not `NULL`, the string is borrowed from the content and
+ *             `view` set to it whenever it needs no escape processing.
+ */
+static TOMLStatus tape_string(TapeWalk *w, String *string,
+                              TOMLStringView *view)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  char const quote = *OFFSET;
+  int const multiline = OFFSET[1] == quote && OFFSET[2] == quote;
+  int const delim_len = multiline ? 3 : 1;
+  uint32_t const close = w->tape->items[w->i + 1];
+  char const *const str_end = w->tape->base + TOML_TAPE_OFFSET(close);
+  try(string_body(ctx, OFFSET + delim_len, str_end, multiline,
+                  (close & TOML_TAPE_ESCAPED) != 0, string, view));
+  w->i += 2;
+  OFFSET = str_end + delim_len;
+
+catch:
+  return status;
+}
+
+/*
+ * @brief Like `parse_key`, but quoted keys are taken from the tape.
+ */
+static TOMLStatus tape_key(TapeWalk *w, String *key, TOMLStringView *view)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  char const c = tape_skip(w, 0);
+  *key = NULL;
+  if (c == '"' || c == '\'')
+  {
+    try(tape_string(w, key, ctx->flags & TOML_F_ZERO_COPY ? view : NULL));
+    if (*key != NULL)
+    {
+      *view = (TOMLStringView) { .data = *key, .len = String_len(*key) };
+    }
+  } else
+  {
+    throw_if(c != 0 || OFFSET >= ctx->end, INVALID_KEY);
+    try(parse_key(ctx, key, view));
+    throw_if(view->len == 0, INVALID_KEY);
+  }
+
+catch:
+  return status;
+}
+
+/*
+ * @brief Finds the value of `key` in `*table_p`, adding it if there's none.
+ *        The key is dropped if the table doesn't take it.
+ */
+static TOMLValue *tape_put(TOMLCtx *ctx, TOMLTable *table_p, String key,
+                           TOMLStringView view)
+{
+  int const count = TOMLTable_count(*table_p);
+  TOMLValue *val_p = put_key(ctx, table_p, &(key), view);
+  if (val_p == NULL || TOMLTable_count(*table_p) == count)
+  {
+    drop_string(ctx, key);
+  }
+  return val_p;
+}
+
+/*
+ * @brief Puts a table at `val_p` unless there's one already.
+ */
+static TOMLStatus tape_subtable(TOMLCtx *ctx, TOMLValue *val_p)
+{
+  if (val_p->kind == 0)
+  {
+    val_p->kind = TOML_TABLE;
+    val_p->table = TOMLTable_new_in(ctx->arena);
+    return val_p->table == NULL ? TOML_E_OOM : TOML_E_OK;
+  }
+  return val_p->kind == TOML_TABLE ? TOML_E_OK : TOML_E_EXPECTED_TABLE;
+}
+
+/*
+ * @brief Skips over the value at the cursor, recording where it is in
+ *        `value`.
+ */
+static TOMLStatus tape_defer(TapeWalk *w, TOMLValue *value)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  TOMLTape const *const tape = w->tape;
+  char const c = tape_skip(w, 0);
+  value->kind = TOML_LAZY;
+  value->lazy = (TOMLLazy) {
+    .offset = OFFSET - tape->base,
+    .token = w->i
+  };
+  if (c == '"' || c == '\'')
+  {
+    int const delim_len = OFFSET[1] == c && OFFSET[2] == c ? 3 : 1;
+    w->i += 2;
+    OFFSET = tape->base + TOML_TAPE_OFFSET(tape->items[w->i - 1]) + delim_len;
+  } else if (c == '[' || c == '{')
+  {
+    // Strings come in pairs of tokens, so the brackets in them don't count.
+    int depth = 0;
+    do {
+      if (w->i >= tape->len)
+      {
+        try(c == '[' ? TOML_E_ARRAY : TOML_E_INLINE_TABLE);
+      }
+      char const token = *tape_token(w);
+      depth += (token == '[' || token == '{') - (token == ']' || token == '}');
+      w->i += token == '"' || token == '\'' ? 2 : 1;
+    } while (depth > 0);
+    OFFSET = tape->base + TOML_TAPE_OFFSET(tape->items[w->i - 1]) + 1;
+  } else
+  {
+    throw_if(c != 0 || OFFSET >= ctx->end, INVALID_VALUE);
+    // A scalar runs up to the first token that isn't a dot.
+    for (; w->i < tape->len && *tape_token(w) == '.'; ++(w->i)) {}
+    OFFSET = tape_token(w);
+  }
+
+catch:
+  return status;
+}
+
+static TOMLStatus tape_entry(TapeWalk *w, TOMLTable *table_p)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  for (;;)
+  {
+    String key;
+    TOMLStringView view = {0};
+    try(tape_key(w, &key, &view));
+    TOMLValue *val_p = tape_put(ctx, table_p, key, view);
+    throw_if(val_p == NULL, OOM);
+    char const c = tape_skip(w, 0);
+    if (c == '.')
+    {
+      tape_next(w);
+      try(tape_subtable(ctx, val_p));
+      table_p = &(val_p->table);
+    } else if (c == '=')
+    {
+      throw_if(val_p->kind != 0, DUPLICATE_KEY);
+      tape_next(w);
+      return w->lazy ? tape_defer(w, val_p) : tape_value(w, val_p);
+    } else
+    {
+      throw(ENTRY_INCOMPLETE);
+    }
+  }
+
+catch:
+  return status;
+}
+
+static TOMLStatus tape_array(TapeWalk *w, TOMLValue *value)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  TOMLValue item = { .kind = 0 };
+  try(array_begin(ctx, value, ctx->flags & TOML_F_PACK_ARRAYS));
+  tape_next(w);
+  for (int expect_value = 1; ; )
+  {
+    char const c = tape_skip(w, 1);
+    if (c == ']')
+    {
+      tape_next(w);
+      break;
+    } else if (c == ',')
+    {
+      throw_if(expect_value, UNEXPECTED_CHAR);
+      tape_next(w);
+      expect_value = 1;
+    } else
+    {
+      throw_if(OFFSET >= ctx->end, ARRAY);
+      throw_if(!expect_value, COMMA_OR_BRACKET);
+      TOMLValue *val_p = array_slot(value, &(item));
+      throw_if(val_p == NULL, OOM);
+      try(tape_value(w, val_p));
+      if (val_p == &(item))
+      {
+        try(array_add(ctx, value, &(item)));
+      }
+      expect_value = 0;
+    }
+  }
+  try(array_end(ctx, value));
+
+catch:
+  if (status != TOML_E_OK)
+  {
+    drop_value(ctx, &(item));
+    TOMLValue_destroy(value);
+    value->array = NULL;
+  }
+  return status;
+}
+
+static TOMLStatus tape_inline_table(TapeWalk *w, TOMLTable *table_p)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  tape_next(w);
+  for (int expect_entry = 1, commas = 0; ; )
+  {
+    char const c = tape_skip(w, 1);
+    if (c == '}')
+    {
+      // No trailing comma
+      throw_if(expect_entry && commas > 0, ENTRY_EXPECTED);
+      tape_next(w);
+      break;
+    } else if (c == ',')
+    {
+      throw_if(expect_entry, ENTRY_EXPECTED);
+      tape_next(w);
+      expect_entry = 1;
+      ++(commas);
+    } else
+    {
+      throw_if(OFFSET >= ctx->end, INLINE_TABLE);
+      throw_if(!expect_entry, ENTRY_UNEXPECTED);
+      try(tape_entry(w, table_p));
+      expect_entry = 0;
+    }
+  }
+
+catch:
+  return status;
+}
+
+static TOMLStatus tape_value(TapeWalk *w, TOMLValue *value)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  switch (tape_skip(w, 0))
+  {
+    CASE('"')
+    CASE('\'')
+    {
+      String string = NULL;
+      TOMLStringView view;
+      value->string = NULL;
+      value->kind = TOML_STRING;
+      try(tape_string(w, &(string), borrow_strings(ctx) ? &(view) : NULL));
+      try(set_string(ctx, value, string, view));
+    } break;
+    CASE('[')
+    {
+      return tape_array(w, value);
+    }
+    CASE('{')
+    {
+      value->kind = TOML_INLINE_TABLE;
+      value->table = TOMLTable_new_in(ctx->arena);
+      throw_if(value->table == NULL, OOM);
+      return tape_inline_table(w, &(value->table));
+    }
+    CASE(0)
+    {
+      throw_if(OFFSET >= ctx->end, INVALID_VALUE);
+      // Numbers, booleans and dates have no structure but the dots in them.
+      try(TOML_parse_value(ctx, value));
+      for (; tape_token(w) < OFFSET; ++(w->i))
+      {
+        throw_if(*tape_token(w) != '.', INVALID_VALUE);
+      }
+    } break;
+    default:
+    {
+      throw(INVALID_VALUE);
+    }
+  }
+
+catch:
+  return status;
+}
+
+/*
+ * @brief Like @link TOML_parse_table_header @endlink, with the cursor at the
+ *        first `[`.
+ */
+static TOMLStatus tape_header(TapeWalk *w, TOMLTable *table_p,
+                              TOMLTable **out_pp)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  tape_next(w);
+  int const is_tblarr = *OFFSET == '[' && OFFSET == tape_token(w);
+  if (is_tblarr)
+  {
+    tape_next(w);
+  }
+  TOMLValue *val_p;
+  for (;;)
+  {
+    String key;
+    TOMLStringView view = {0};
+    try(tape_key(w, &key, &view));
+    val_p = tape_put(ctx, table_p, key, view);
+    throw_if(val_p == NULL, OOM);
+    char const c = tape_skip(w, 0);
+    if (c == ']')
+    {
+      tape_next(w);
+      break;
+    }
+    throw_if(c != '.', INVALID_HEADER);
+    tape_next(w);
+    try(tape_subtable(ctx, val_p));
+    table_p = &(val_p->table);
+  }
+  if (is_tblarr)
+  {
+    throw_if(*OFFSET != ']' || OFFSET != tape_token(w), TABLE_ARRAY_HEADER);
+    tape_next(w);
+    if (val_p->kind == 0)
+    {
+      val_p->kind = TOML_TABLE_ARRAY;
+      val_p->array = TOMLArray_new_in(ctx->arena);
+      throw_if(val_p->array == NULL, OOM);
+    }
+    throw_if(val_p->kind != TOML_TABLE_ARRAY, EXPECTED_TABLE_ARRAY);
+    TOMLValue *tblval_p = TOMLArray_push_empty(&(val_p->array));
+    throw_if(tblval_p == NULL, OOM);
+    try(tape_subtable(ctx, tblval_p));
+    *out_pp = &(tblval_p->table);
+  } else
+  {
+    throw_if(*OFFSET == ']' && OFFSET == tape_token(w), TABLE_HEADER);
+    try(tape_subtable(ctx, val_p));
+    *out_pp = &(val_p->table);
+  }
+
+catch:
+  return status;
+}
+
+static TOMLStatus tape_document(TapeWalk *w, TOMLTable *table_p)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = w->ctx;
+  TOMLTable *current = table_p;
+  for (;;)
+  {
+    char const c = tape_skip(w, 1);
+    if (OFFSET >= ctx->end)
+    {
+      break;
+    } else if (c == '[')
+    {
+      try(tape_header(w, table_p, &(current)));
+    } else
+    {
+      try(tape_entry(w, current));
+    }
+    // Whatever follows has to be on a line of its own.
+    throw_if(tape_skip(w, 0) != '\n' && OFFSET < ctx->end, UNEXPECTED_CHAR);
+  }
+
+catch:
+  return status;
+}
+
+/**
+ * @brief Parses a TOML buffer that was indexed by
+ *        @link TOMLTape_build @endlink.
+ *
+ * The tree is the same @link TOML_parse @endlink builds, but the parser
+ * jumps from a token to the next instead of looking at every byte, only the
+ * keys and scalar values are read in full. The content has to be the one the
+ * tape was built from, with the cursor where it was.
+ */
+TOMLStatus TOML_parse_tape(TOMLCtx *ctx, TOMLTape const *tape,
+                           TOMLTable *table_p)
+{
+  TapeWalk walk = { .ctx = ctx, .tape = tape, .i = 0, .lazy = 0 };
+  return tape_document(&(walk), table_p);
+}
+
+/**
+ * @brief Indexes the content of `ctx` and builds the tables and keys of the
+ *        document, leaving the values to be decoded on access.
+ *
+ * `ctx` is copied, the document takes over its cursor. Keys are always
+ * borrowed when they have no escapes, the `TOML_F_*` flags of `ctx` only
+ * apply to the values. `doc` has to be destroyed even if this fails.
+ */
+TOMLStatus TOMLDoc_open(TOMLDoc *doc, TOMLCtx const *ctx)
+{
+  TOMLStatus status = TOML_E_OK;
+  TapeWalk walk = { .ctx = &(doc->ctx), .tape = &(doc->tape), .lazy = 1 };
+  doc->ctx = *ctx;
+  TOMLTape_init(&(doc->tape));
+  doc->root = TOMLTable_new_in(ctx->arena);
+  throw_if(doc->root == NULL, OOM);
+  try(TOMLTape_build(&(doc->tape), &(doc->ctx)));
+  doc->ctx.flags |= TOML_F_ZERO_COPY;
+  status = tape_document(&(walk), &(doc->root));
+  doc->ctx.flags = ctx->flags;
+
+catch:
+  return status;
+}
+
+/*
+ * @brief Replaces a @link TOML_LAZY @endlink value with what it decodes to.
+ */
+static TOMLStatus doc_decode(TOMLDoc *doc, TOMLValue *value)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLCtx *const ctx = &(doc->ctx);
+  TapeWalk walk = {
+    .ctx = ctx,
+    .tape = &(doc->tape),
+    .i = value->lazy.token,
+    .lazy = 0
+  };
+  TOMLValue decoded;
+  memset(&(decoded), 0, sizeof(decoded));
+  OFFSET = doc->tape.base + value->lazy.offset;
+  try(tape_value(&(walk), &(decoded)));
+  // The span of a scalar ends at the next token, it must all be used up.
+  throw_if(tape_skip(&(walk), 0) == 0 && OFFSET < ctx->end, UNEXPECTED_CHAR);
+  *value = decoded;
+
+catch:
+  if (status != TOML_E_OK)
+  {
+    if (decoded.kind == TOML_STRING)
+    {
+      drop_string(ctx, decoded.string);
+    } else if (decoded.kind == TOML_INLINE_TABLE && decoded.table != NULL)
+    {
+      TOMLTable_destroy(decoded.table);
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Looks `key` up in `table`, a table of `doc`, decoding its value if
+ *        it's the first time.
+ * @param val_pp Set to the value, or to `NULL` if there's no such key.
+ * @returns The status of decoding the value, in which case it is left
+ *          undecoded and `doc->ctx` tells where the error is.
+ */
+TOMLStatus TOMLDoc_get_view(TOMLDoc *doc, TOMLTable table, TOMLStringView key,
+                            TOMLValue const **val_pp)
+{
+  TOMLStatus status = TOML_E_OK;
+  // The document owns its tables, so the value can be decoded in place.
+  TOMLValue *val_p = (TOMLValue *)TOMLTable_get_view(table, key);
+  if (val_p != NULL && val_p->kind == TOML_LAZY)
+  {
+    status = doc_decode(doc, val_p);
+  }
+  *val_pp = status == TOML_E_OK ? val_p : NULL;
+  return status;
+}
+
+TOMLStatus TOMLDoc_get(TOMLDoc *doc, TOMLTable table, String key,
+                       TOMLValue const **val_pp)
+{
+  TOMLStringView const view = { .data = key, .len = String_len(key) };
+  return TOMLDoc_get_view(doc, table, view, val_pp);
+}
+
+void TOMLDoc_destroy(TOMLDoc *doc)
+{
+  if (doc->root != NULL)
+  {
+    TOMLTable_destroy(doc->root);
+    doc->root = NULL;
+  }
+  TOMLTape_destroy(&(doc->tape));
+}
+
+#define EMIT(ev, callback, ...)                                 \
+  if ((ev)->callback != NULL)                                   \
+  {                                                             \
+    try((ev)->callback((ev)->data, __VA_ARGS__));               \
+  }
+#define EMIT_MARK(ev, callback)                                 \
+  if ((ev)->callback != NULL)                                   \
+  {                                                             \
+    try((ev)->callback((ev)->data));                            \
+  }
+
+typedef struct EventKeys {
+  TOMLStringView views[TOML_EVENTS_MAX_KEYS];
+  String         strings[TOML_EVENTS_MAX_KEYS]; ///< The keys that had to be
+                                                ///< unescaped.
+  int            count;
+} EventKeys;
+
+static TOMLStatus event_value(TOMLCtx *, TOMLEvents const *);
+
+static void drop_keys(EventKeys *keys)
+{
+  for (int i = 0; i < keys->count; ++(i))
+  {
+    if (keys->strings[i] != NULL)
+    {
+      String_cleanup(keys->strings[i]);
+    }
+  }
+  keys->count = 0;
+}
+
+/*
+ * @brief Parses the parts of a dotted key up to `stop`, which is left at
+ *        `OFFSET`.
+ */
+static TOMLStatus event_keys(TOMLCtx *ctx, EventKeys *keys, char stop)
+{
+  TOMLStatus status = TOML_E_OK;
+  for (;;)
+  {
+    for (; *OFFSET == ' ' || *OFFSET == '\t'; ++(OFFSET)) {}
+    char const c = *OFFSET;
+    throw_if(!(is_letter(c) || is_digit(c) || c == '_' || c == '-' ||
+               c == '"' || c == '\''), INVALID_KEY);
+    throw_if(keys->count == TOML_EVENTS_MAX_KEYS, INVALID_KEY);
+    int const i = keys->count++;
+    keys->views[i] = (TOMLStringView) {0};
+    try(parse_key(ctx, &(keys->strings[i]), &(keys->views[i])));
+    for (; *OFFSET == ' ' || *OFFSET == '\t'; ++(OFFSET)) {}
+    if (*OFFSET == '.')
+    {
+      ++(OFFSET);
+    } else if (*OFFSET == stop)
+    {
+      break;
+    } else
+    {
+      throw_if(stop == ']', INVALID_HEADER);
+      throw(ENTRY_INCOMPLETE);
+    }
+  }
+catch:
+  return status;
+}
+
+static TOMLStatus event_entry(TOMLCtx *ctx, TOMLEvents const *ev)
+{
+  TOMLStatus status = TOML_E_OK;
+  EventKeys keys;
+  keys.count = 0;
+  try(event_keys(ctx, &(keys), '='));
+  ++(OFFSET);
+  EMIT(ev, on_key, keys.views, keys.count);
+  drop_keys(&(keys));
+  try(event_value(ctx, ev));
+catch:
+  drop_keys(&(keys));
+  return status;
+}
+
+static TOMLStatus event_header(TOMLCtx *ctx, TOMLEvents const *ev)
+{
+  TOMLStatus status = TOML_E_OK;
+  EventKeys keys;
+  keys.count = 0;
+  int const is_tblarr = OFFSET[1] == '[';
+  OFFSET += 1 + is_tblarr;
+  try(event_keys(ctx, &(keys), ']'));
+  ++(OFFSET);
+  if (is_tblarr)
+  {
+    throw_if(*OFFSET != ']', TABLE_ARRAY_HEADER);
+    ++(OFFSET);
+  }
+  EMIT(ev, on_table_header, keys.views, keys.count, is_tblarr);
+catch:
+  drop_keys(&(keys));
+  return status;
+}
+
+static TOMLStatus event_array(TOMLCtx *ctx, TOMLEvents const *ev)
+{
+  TOMLStatus status = TOML_E_OK;
+  char const *const end = ctx->end;
+  EMIT_MARK(ev, on_array_begin);
+  ++(OFFSET);
+  for (int expect_value = 1; OFFSET < end; )
+  {
+    char const chr = *OFFSET;
+    if (chr == ']')
+    {
+      break;
+    } else if (chr == ' ' || chr == '\n' || chr == '\t' || chr == '\r')
+    {
+      ++(OFFSET);
+    } else if (chr == '#')
+    {
+      char const *nl = strchr(OFFSET, '\n');
+      throw_if(nl == NULL, ARRAY);
+      OFFSET = nl + 1;
+    } else if (chr == ',')
+    {
+      throw_if(expect_value, UNEXPECTED_CHAR);
+      ++(OFFSET);
+      expect_value = 1;
+    } else
+    {
+      throw_if(!expect_value, COMMA_OR_BRACKET);
+      try(event_value(ctx, ev));
+      expect_value = 0;
+    }
+  }
+  throw_if(*OFFSET != ']', ARRAY);
+  ++(OFFSET);
+  EMIT_MARK(ev, on_array_end);
+catch:
+  return status;
+}
+
+static TOMLStatus event_inline_table(TOMLCtx *ctx, TOMLEvents const *ev)
+{
+  TOMLStatus status = TOML_E_OK;
+  char const *const end = ctx->end;
+  EMIT_MARK(ev, on_inline_table_begin);
+  ++(OFFSET);
+  for (int expect_entry = 1; OFFSET < end; )
+  {
+    char const chr = *OFFSET;
+    if (is_empty(chr))
+    {
+      ++(OFFSET);
+    } else if (chr == ',')
+    {
+      throw_if(expect_entry, ENTRY_EXPECTED);
+      expect_entry = 1;
+      ++(OFFSET);
+    } else if (chr == '}')
+    {
+      break;
+    } else
+    {
+      throw_if(!expect_entry, ENTRY_UNEXPECTED);
+      expect_entry = 0;
+      try(event_entry(ctx, ev));
+    }
+  }
+  throw_if(*OFFSET != '}', INLINE_TABLE);
+  ++(OFFSET);
+  EMIT_MARK(ev, on_inline_table_end);
+catch:
+  return status;
+}
+
+static TOMLStatus event_value(TOMLCtx *ctx, TOMLEvents const *ev)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLValue value;
+  for (; *OFFSET == ' ' || *OFFSET == '\t'; ++(OFFSET)) {}
+  if (*OFFSET == '[')
+  {
+    return event_array(ctx, ev);
+  } else if (*OFFSET == '{')
+  {
+    return event_inline_table(ctx, ev);
+  }
+  // The scalars are parsed as usual, they don't allocate anything but
+  // escaped strings.
+  try(TOML_parse_value(ctx, &(value)));
+  switch (value.kind)
+  {
+    CASE(TOML_INTEGER)
+    {
+      EMIT(ev, on_integer, value.integer);
+    } break;
+    CASE(TOML_FLOAT)
+    {
+      EMIT(ev, on_float, value.float_);
+    } break;
+    CASE(TOML_BOOLEAN)
+    {
+      EMIT(ev, on_boolean, value.integer != 0);
+    } break;
+    CASE(TOML_STRING)
+    {
+      if (ev->on_string != NULL)
+      {
+        status = ev->on_string(ev->data, TOMLValue_string(&(value)));
+      }
+      String_cleanup(value.string);
+    } break;
+    CASE(TOML_STRING_VIEW)
+    {
+      EMIT(ev, on_string, value.view);
+    } break;
+    CASE(TOML_SHORT_STRING)
+    {
+      EMIT(ev, on_string, TOMLValue_string(&(value)));
+    } break;
+    default:
+    {
+      EMIT(ev, on_datetime, &(value));
+    } break;
+  }
+catch:
+  return status;
+}
+
+/**
+ * @brief Parses a TOML buffer, calling the callbacks of `ev` instead of
+ *        building a table.
+ *
+ * Strings and keys are borrowed from the content whenever they need no
+ * unescaping, whatever the flags of `ctx` are, and nothing is allocated from
+ * its arena.
+ */
+TOMLStatus TOML_parse_events(TOMLCtx *ctx, TOMLEvents const *ev)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLArena *const arena = ctx->arena;
+  int const flags = ctx->flags;
+  ctx->arena = NULL;
+  ctx->flags |= TOML_F_ZERO_COPY;
+  for (; OFFSET < ctx->end; )
+  {
+    char const chr = *OFFSET;
+    if (is_empty(chr) || chr == '\r')
+    {
+      ++(OFFSET);
+    } else if (chr == '#')
+    {
+      skip_comment(OFFSET);
+    } else if (chr == '[')
+    {
+      try(event_header(ctx, ev));
+    } else
+    {
+      try(event_entry(ctx, ev));
+    }
+  }
+catch:
+  ctx->arena = arena;
+  ctx->flags = flags;
+  return status;
+}
@@ -7,6 +7,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <c-string/lib.h> // https://github.com/fabriciopashaj/c-string
+#include "arena.h"
+#include "intern.h"
 
 // TOML data type ids
 #ifdef DEBUG
@@ -27,7 +29,11 @@ typedef enum TOMLKind {
   K(ARRAY),
   K(TABLE),
   K(INLINE_TABLE),
-  K(TABLE_ARRAY)
+  K(TABLE_ARRAY),
+  K(STRING_VIEW),
+  K(LAZY),
+  K(PACKED_ARRAY),
+  K(SHORT_STRING)
 #undef K
 } TOMLKind;
 
@@ -44,6 +50,10 @@ typedef enum TOMLKind {
 #define TOML_TABLE        9
 #define TOML_INLINE_TABLE 10
 #define TOML_TABLE_ARRAY  11
+#define TOML_STRING_VIEW  12
+#define TOML_LAZY         13
+#define TOML_PACKED_ARRAY 14
+#define TOML_SHORT_STRING 15
 
 typedef uint8_t TOMLKind;
 
@@ -78,6 +88,8 @@ typedef uint8_t TOMLKind;
 #define TOML_E_TABLE_HEADER            25
 #define TOML_E_TABLE_ARRAY_HEADER      26
 #define TOML_E_EOF                     27
+#define TOML_E_IO                      28
+#define TOML_E_SECTION_TOO_BIG         29
 // STATUSES END
 
 // Typedefing the structs before defining their bodies
@@ -85,10 +97,14 @@ typedef struct TOMLDate         TOMLDate;
 typedef struct TOMLTime         TOMLTime;
 typedef struct TOMLDateTime     TOMLDateTime;
 typedef struct TOMLValue        TOMLValue;
+typedef struct TOMLStringView   TOMLStringView;
+typedef struct TOMLLazy         TOMLLazy;
 typedef struct TOMLCtx          TOMLCtx; // more like parsing state
 typedef struct TOMLPosition     TOMLPosition; // position of the cursor
+typedef struct TOMLFileResult   TOMLFileResult;
 // Typedefing array types
 typedef struct TOMLValue*   TOMLArray;
+typedef struct TOMLPackedArray_Header *TOMLPackedArray;
 // The table
 typedef struct TOMLTable_Bucket TOMLTable_Bucket;
 typedef struct TOMLTable_Bucket *TOMLTable;
@@ -126,30 +142,74 @@ struct TOMLDateTime {
   TOMLTime time;
 };
 
+/**
+ * @struct TOMLStringView
+ * @brief A string borrowed from the parsed content. It is not NUL terminated
+ *        and is valid only as long as the content is.
+ */
+struct TOMLStringView {
+  char const *data;
+  int         len;
+}__attribute__((packed));
+
+/**
+ * @struct TOMLLazy
+ * @brief Where the value of a @link TOMLDoc @endlink entry that wasn't
+ *        decoded yet is.
+ */
+struct TOMLLazy {
+  uint32_t offset; ///< The offset of the value from the start of the tape.
+  int32_t  token;  ///< The first token of the tape that is part of it or
+                   ///< follows it.
+}__attribute__((packed));
+
+#define TOML_SHORT_STRING_MAX 11 ///< The longest string a value holds inline.
+
 /**
  * @struct TOMLValue
  * @brief A tagged union wrapping the different TOML values.
+ *
+ * Values are 16 bytes and aligned to that: the payload takes the first 12
+ * and the kind follows it, so the items of arrays and the values of tables
+ * never straddle cache lines and their integers and floats are aligned.
+ *
+ * A @link TOML_SHORT_STRING @endlink keeps its bytes in `short_string`,
+ * followed by a null byte, and its last byte holds how much shorter than
+ * @link TOML_SHORT_STRING_MAX @endlink the string is, so that it doubles as
+ * the null byte of the longest ones.
  */
 struct TOMLValue {
   union {
-    String       string;
-    signed long  integer;
-    double       float_; // it's still a float, just double precision
-    bool         boolean;
-    TOMLArray    array;
-    TOMLTable    table;
-    TOMLDate     date;
-    TOMLTime     time;
-    TOMLDateTime datetime;
+    String         string;
+    TOMLStringView view;   // when `kind` is TOML_STRING_VIEW
+    TOMLLazy       lazy;   // when `kind` is TOML_LAZY
+    char           short_string[TOML_SHORT_STRING_MAX + 1];
+                           // when `kind` is TOML_SHORT_STRING
+    signed long    integer;
+    double         float_; // it's still a float, just double precision
+    bool           boolean;
+    TOMLArray      array;
+    TOMLPackedArray packed; // when `kind` is TOML_PACKED_ARRAY
+    TOMLTable      table;
+    TOMLDate       date;
+    TOMLTime       time;
+    TOMLDateTime   datetime;
   }__attribute__((packed));
   TOMLKind kind; ///< The kind of the TOML value.
-}__attribute__((packed));
+}__attribute__((aligned(16)));
+
+#include "array.h"
+
+// How many zero bytes there are past the end of a mapped file at least
+#define TOML_MMAP_PADDING 64
 
-#define CVECTOR_POINTERMODE
-#define CVECTOR_NO_TYPEDEF
-#include <c-vector/lib.h> // https://github.com/fabriciopashaj/c-vector
-CVECTOR_WITH_NAME(TOMLValue, TOMLArray);
-void TOMLArray_destroy(TOMLArray);
+// Context flags
+#define TOML_F_ZERO_COPY (1 << 0) ///< Borrow the strings and keys that need no
+                                  ///< escape processing from the content.
+#define TOML_F_PACK_ARRAYS (1 << 1) ///< Store arrays of integers, floats,
+                                    ///< booleans or strings unboxed.
+#define TOML_F_SHORT_STRINGS (1 << 2) ///< Store short strings inside their
+                                      ///< value instead of allocating them.
 
 /**
  * @struct TOMLCtx
@@ -159,10 +219,18 @@ void TOMLArray_destroy(TOMLArray);
  * TOML data to parse without them interfering with each other.
  */
 struct TOMLCtx {
-  StringBuffer content; ///< The StringBuffer with the TOML data.
+  StringBuffer content; ///< The StringBuffer with the TOML data, or the
+                        ///< mapping of a file.
   char const   *end;    ///< The address of the end of the content.
   char const   *offset; ///< The pointer to the part of the content that will
                         ///< be used by the next call of a parsing function.
+  TOMLArena    *arena;  ///< The arena where the parsed values are allocated,
+                        ///< `NULL` to allocate them on the heap.
+  int          flags;   ///< The `TOML_F_*` flags of the context.
+  TOMLInterner *keys;   ///< The interner the keys are put through, `NULL`
+                        ///< to give every key its own copy.
+  size_t       mapped;  ///< The size of the mapping that holds the content,
+                        ///< `0` if the content isn't a mapped file.
 };
 
 /**
@@ -175,7 +243,26 @@ struct TOMLPosition {
   int column; ///< The column position of the cursor.
 };
 
+/**
+ * @struct TOMLFileResult
+ * @brief What parsing one of the files given to
+ *        @link TOML_parse_many @endlink came to.
+ */
+struct TOMLFileResult {
+  TOMLTable    table;    ///< The parsed file, `NULL` if it failed.
+  TOMLStatus   status;
+  TOMLPosition position; ///< Where the error is, if it's a parsing error.
+};
+
 void        TOML_init              (TOMLCtx *, StringBuffer);
+void        TOML_init_arena        (TOMLCtx *, StringBuffer, TOMLArena *);
+TOMLStatus  TOML_init_mmap         (TOMLCtx *, char const *, TOMLArena *);
+/**
+ * @fn TOML_unmap(TOMLCtx *ctx)
+ * @brief Releases the file mapped by @link TOML_init_mmap @endlink, along
+ *        with every string borrowed from it.
+ */
+void        TOML_unmap             (TOMLCtx *);
 TOMLStatus  TOML_parse_value       (TOMLCtx *, TOMLValue *);
 TOMLStatus  TOML_parse_number      (TOMLCtx *, TOMLValue *);
 TOMLStatus  TOML_parse_sl_string   (TOMLCtx *, String *);
@@ -192,6 +279,11 @@ TOMLStatus  TOML_parse_table       (TOMLCtx *, TOMLTable *);
  * @brief Parses a TOML buffer.
  */
 TOMLStatus  TOML_parse             (TOMLCtx *, TOMLTable *);
+TOMLStatus  TOML_parse_file        (TOMLCtx *, char const *, TOMLArena *, int,
+                                    TOMLInterner *, TOMLTable *);
+TOMLStatus  TOML_parse_parallel    (TOMLCtx *, TOMLTable *, int);
+TOMLStatus  TOML_parse_many        (char const *const *, int, TOMLArena *, int,
+                                    TOMLInterner *, TOMLFileResult *, int);
 
 /**
  * @fn TOMLValue_destroy(TOMLValue *value)
@@ -201,6 +293,13 @@ TOMLStatus  TOML_parse             (TOMLCtx *, TOMLTable *);
  * contains recursively.
  */
 void TOMLValue_destroy(TOMLValue *);
+/**
+ * @fn TOMLValue_string(TOMLValue const *value)
+ * @brief Gets the contents of a @link TOML_STRING @endlink,
+ *        @link TOML_STRING_VIEW @endlink or @link TOML_SHORT_STRING @endlink
+ *        value, which is null terminated unless it's a view.
+ */
+TOMLStringView TOMLValue_string(TOMLValue const *);
 /**
  * @fn TOML_position(TOMLCtx const *ctx)
  * @brief Get the position of the parsing context `ctx`.
@@ -208,5 +307,12 @@ void TOMLValue_destroy(TOMLValue *);
 TOMLPosition TOML_position(TOMLCtx const *);
 
 #include "table.h"
+#include "stream.h"
+#include "events.h"
+#include "tape.h"
+#include "doc.h"
+#include "snapshot.h"
+#include "reload.h"
+#include "watch.h"
 
 #endif /* C_TOML_H */
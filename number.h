@@ -0,0 +1,38 @@
+/*
+ * @file number.h
+ * @brief Conversion kernels used by the number parser.
+ */
+
+#ifndef C_TOML_NUMBER_H
+#define C_TOML_NUMBER_H
+#include "lib.h"
+
+#define PARSE_INT_NEG (1 << 0)
+#define PARSE_INT_ILZ (1 << 1) // (I)gnore (L)eading (Z)eroes
+
+/**
+ * @fn TOML_parse_int(char const **buf_p, char const *end, int base, int info,
+ *                    signed long *res_p)
+ * @brief Parses the digits of an integer in the given base, along with the
+ *        `_` separators between them.
+ * @param buf_p The cursor, it is left after the last digit.
+ * @param info A combination of `PARSE_INT_NEG` and `PARSE_INT_ILZ`.
+ * @returns @link TOML_E_INT_OVERFLOW @endlink if the value doesn't fit in a
+ *          `signed long`, in which case `*res_p` is set to the closest limit.
+ */
+TOMLStatus TOML_parse_int(char const **, char const *, int, int,
+                          signed long *);
+/**
+ * @fn TOML_parse_float(char const **buf_p, char const *end, int neg,
+ *                      double *res_p)
+ * @brief Parses the unsigned decimal float at `*buf_p` and rounds it to the
+ *        nearest double.
+ * @param buf_p The cursor, it is left after the last character of the float.
+ * @param neg Whether the sign that preceded the float was a `-`.
+ * @returns @link TOML_E_INVALID_NUMBER @endlink if the exponent has no digits,
+ *          @link TOML_E_FLOAT_OVERFLOW @endlink if the value is too big to be
+ *          represented, in which case `*res_p` is set to an infinity.
+ */
+TOMLStatus TOML_parse_float(char const **, char const *, int, double *);
+
+#endif /* C_TOML_NUMBER_H */
@@ -0,0 +1,253 @@
+/*
+ * @file parallel.c
+ * @brief Parsing the top-level sections of a document on several threads.
+ *
+ * The document is cut at top-level headers into chunks of whole sections,
+ * which worker threads parse as documents of their own, each into its own
+ * table and arena. The tables are then merged in document order, which is
+ * when keys and tables defined by more than one chunk are caught.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "pool.h"
+
+#define PARALLEL_MIN_CHUNK (256 * 1024) // Smaller chunks aren't worth a thread
+#define CHUNKS_PER_THREAD  4            // So that threads that got quick
+                                        // chunks can take more
+
+#define throw(err) { status = TOML_E_##err; goto catch; }
+#define try(thing) { status = (thing); if (status) { goto catch; } }
+#define throw_if(cond, err) if (cond) { throw(err); }
+
+typedef struct Chunk {
+  char const *start;
+  char const *end;
+  char const *stop;   ///< Where the cursor was left after parsing.
+  TOMLStatus  status;
+  TOMLTable   table;
+} Chunk;
+
+typedef struct Pool {
+  TOMLCtx const *ctx;
+  Chunk         *chunks;
+  int            count;
+  int            next;   ///< The next chunk to be taken, shared by the
+                         ///< workers.
+} Pool;
+
+typedef struct Worker {
+  TOMLPool_Worker base;
+  Pool           *pool;
+} Worker;
+
+/*
+ * @brief Parses chunks until there are none left.
+ */
+static void *work(void *arg)
+{
+  Worker *const worker = arg;
+  Pool *const pool = worker->pool;
+  TOMLArena *const arena = pool->ctx->arena == NULL ?
+                           NULL : &(worker->base.arena);
+  for (;;)
+  {
+    int const i = __atomic_fetch_add(&(pool->next), 1, __ATOMIC_RELAXED);
+    if (i >= pool->count)
+    {
+      break;
+    }
+    Chunk *const chunk = &(pool->chunks[i]);
+    TOMLCtx ctx = *(pool->ctx);
+    ctx.offset = chunk->start;
+    ctx.end = chunk->end;
+    ctx.arena = arena;
+    chunk->table = TOMLTable_new_in(arena);
+    chunk->status = chunk->table == NULL ? TOML_E_OOM :
+                                           TOML_parse(&ctx, &(chunk->table));
+    chunk->stop = ctx.offset;
+  }
+  return NULL;
+}
+
+/*
+ * @brief Cuts the content of `ctx` from the cursor on into chunks of whole
+ *        sections, of at least `size` bytes but the last.
+ * @returns The number of chunks, `-1` if the system is out of memory.
+ */
+static int split_chunks(TOMLCtx const *ctx, size_t size, Chunk **chunks_p)
+{
+  char const *const base = ctx->offset;
+  size_t const len = ctx->end - base;
+  char const *start = base;
+  int count = 0;
+  int cap = 0;
+  Chunk *chunks = NULL;
+  TOMLSplitter splitter;
+  TOMLSplitter_init(&splitter);
+  for (size_t scanned = 0; start < ctx->end; )
+  {
+    int header;
+    scanned += TOML_split(&(splitter), base + scanned, len - scanned, 1,
+                          &(header));
+    // A section ends right before the header of the next one.
+    char const *const cut = header ? base + scanned - 1 : ctx->end;
+    if (header && (size_t)(cut - start) < size)
+    {
+      continue;
+    } else if (count == cap)
+    {
+      cap = cap < 16 ? 16 : cap * 2;
+      Chunk *grown = realloc(chunks, cap * sizeof(Chunk));
+      if (grown == NULL)
+      {
+        free(chunks);
+        return -1;
+      }
+      chunks = grown;
+    }
+    chunks[count++] = (Chunk) { .start = start, .end = cut };
+    start = cut;
+  }
+  *chunks_p = chunks;
+  return count;
+}
+
+/*
+ * @brief Frees a key that was taken out of a table, unless it's borrowed or
+ *        lives in an arena.
+ */
+static void drop_key(TOMLArena const *arena, TOMLTable_Bucket *bucket)
+{
+  if (arena == NULL && !bucket->borrowed)
+  {
+    String_cleanup(bucket->key);
+  }
+  bucket->key = NULL;
+}
+
+/*
+ * @brief Moves the entries of `src`, which was parsed out of a later part
+ *        of the document, into `*dst_p`, as if they had been parsed into it.
+ *
+ * Tables are merged and table arrays appended to, anything else defined in
+ * both is an error. The keys of the entries that were moved are cleared in
+ * `src`, so destroying it afterwards only frees what's left.
+ */
+static TOMLStatus merge(TOMLTable *dst_p, TOMLTable src)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLArena const *const arena = TOMLTable_header(src)->arena;
+  for (int i = 0; i < TOMLTable_len(src); ++(i))
+  {
+    TOMLTable_Bucket *const bucket = &(src[i]);
+    TOMLValue *const from = TOMLTable_value(src, i);
+    if (bucket->key == NULL)
+    {
+      continue;
+    }
+    TOMLStringView const key = { bucket->key, bucket->key_len };
+    int const count = TOMLTable_count(*dst_p);
+    TOMLValue *to = bucket->borrowed ? TOMLTable_put_view(dst_p, key) :
+                                       TOMLTable_put(dst_p, bucket->key);
+    throw_if(to == NULL, OOM);
+    if (TOMLTable_count(*dst_p) != count)
+    {
+      // The key wasn't there, the table took it.
+      *to = *from;
+      bucket->key = NULL;
+      continue;
+    } else if (from->kind == TOML_TABLE)
+    {
+      throw_if(to->kind != TOML_TABLE, EXPECTED_TABLE);
+      try(merge(&(to->table), from->table));
+      TOMLTable_destroy(from->table);
+    } else if (from->kind == TOML_TABLE_ARRAY)
+    {
+      throw_if(to->kind != TOML_TABLE_ARRAY, EXPECTED_TABLE_ARRAY);
+      for (int j = 0; j < TOMLArray_len(from->array); ++(j))
+      {
+        throw_if(TOMLArray_push(&(to->array), &(from->array[j])) != 0, OOM);
+        from->array[j].kind = 0;
+      }
+      TOMLArray_cleanup(from->array);
+    } else
+    {
+      throw(DUPLICATE_KEY);
+    }
+    drop_key(arena, bucket);
+  }
+
+catch:
+  return status;
+}
+
+/**
+ * @brief Parses a document like @link TOML_parse @endlink, but parses its
+ *        top-level sections on `threads` threads.
+ * @param threads How many threads to use, `0` for one per processor.
+ * @returns The status of the first error in the document, in which case the
+ *          cursor is left where it is, or at the start of the chunk of
+ *          sections with the key or table that was already defined.
+ *
+ * The document is parsed serially if it's too small to be worth splitting
+ * or if the keys are interned, since interners aren't thread-safe. Each
+ * thread allocates from an arena of its own if `ctx` has an arena, which is
+ * handed over to the arena of `ctx` once the tables are merged.
+ */
+TOMLStatus TOML_parse_parallel(TOMLCtx *ctx, TOMLTable *table_p, int threads)
+{
+  TOMLStatus status = TOML_E_OK;
+  size_t const len = ctx->end - ctx->offset;
+  threads = TOML_pool_threads(threads, INT_MAX);
+  if (threads <= 1 || ctx->keys != NULL || len < 2 * PARALLEL_MIN_CHUNK)
+  {
+    return TOML_parse(ctx, table_p);
+  }
+  size_t size = len / ((size_t)threads * CHUNKS_PER_THREAD);
+  Chunk *chunks = NULL;
+  Worker *workers = NULL;
+  int const count = split_chunks(ctx, size < PARALLEL_MIN_CHUNK ?
+                                      PARALLEL_MIN_CHUNK : size, &(chunks));
+  throw_if(count < 0, OOM);
+  threads = TOML_pool_threads(threads, count);
+  workers = calloc(threads, sizeof(Worker));
+  throw_if(workers == NULL, OOM);
+  Pool pool = { .ctx = ctx, .chunks = chunks, .count = count, .next = 0 };
+  for (int i = 0; i < threads; ++(i))
+  {
+    workers[i].pool = &(pool);
+  }
+  TOML_pool_run(workers, sizeof(Worker), threads, ctx->arena, work);
+
+  for (int i = 0; i < count; ++(i))
+  {
+    Chunk *const chunk = &(chunks[i]);
+    ctx->offset = chunk->stop;
+    try(chunk->status);
+    ctx->offset = chunk->start;
+    try(merge(table_p, chunk->table));
+    TOMLTable_destroy(chunk->table);
+    chunk->table = NULL;
+    ctx->offset = chunk->stop;
+  }
+
+catch:
+  for (int i = 0; i < count; ++(i))
+  {
+    if (chunks[i].table != NULL)
+    {
+      TOMLTable_destroy(chunks[i].table);
+    }
+  }
+  if (workers != NULL && ctx->arena != NULL)
+  {
+    TOML_pool_rehome(*table_p, ctx->arena);
+    TOML_pool_finish(workers, sizeof(Worker), threads, ctx->arena);
+  }
+  free(workers);
+  free(chunks);
+  return status;
+}
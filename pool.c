@@ -0,0 +1,134 @@
+/*
+ * @file pool.c
+ * @brief The thread pool shared by the parsers that run on several threads.
+ *
+ * Every worker allocates from an arena of its own, so that the threads don't
+ * contend for the arena of the results. Once they are done, the blocks of
+ * those arenas are handed over to it, and the tables and arrays that were
+ * built in them are pointed at it, since the worker arenas go away with the
+ * workers.
+ */
+
+#include <unistd.h>
+#include "pool.h"
+
+#define WORKER(workers, size, i) \
+  ((TOMLPool_Worker *)((char *)(workers) + (size) * (i)))
+
+/**
+ * @brief How many threads to run `jobs` jobs on, when asked for `threads`,
+ *        `0` for one per processor.
+ */
+int TOML_pool_threads(int threads, int jobs)
+{
+  if (threads <= 0)
+  {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  threads = threads < jobs ? threads : jobs;
+  return threads < 1 ? 1 : threads;
+}
+
+/**
+ * @brief Runs `work` on each of the `count` workers, of `size` bytes each,
+ *        at `workers`, and waits for all of them to return.
+ * @param arena The arena of the results, which the arenas of the workers
+ *              take their block size from, or `NULL`.
+ *
+ * This thread is the first worker. If the others can't all be started, the
+ * ones that were have to pick up their share, so `work` has to keep going
+ * until there is nothing left to do rather than do a fixed part of it.
+ */
+void TOML_pool_run(void *workers, size_t size, int count,
+                   TOMLArena const *arena, void *(*work)(void *))
+{
+  for (int i = 0; i < count; ++(i))
+  {
+    TOMLArena_init(&(WORKER(workers, size, i)->arena),
+                   arena == NULL ? 0 : arena->block_size);
+  }
+  int started;
+  for (started = 1; started < count; ++(started))
+  {
+    TOMLPool_Worker *const worker = WORKER(workers, size, started);
+    if (pthread_create(&(worker->thread), NULL, work, worker) != 0)
+    {
+      break;
+    }
+  }
+  work(WORKER(workers, size, 0));
+  for (int i = 1; i < started; ++(i))
+  {
+    pthread_join(WORKER(workers, size, i)->thread, NULL);
+  }
+}
+
+/**
+ * @brief Hands the blocks of the arenas of the workers over to `arena`,
+ *        if the results went in one.
+ *
+ * The results have to be pointed at `arena` with
+ * @link TOML_pool_rehome @endlink before the workers are freed.
+ */
+void TOML_pool_finish(void *workers, size_t size, int count,
+                      TOMLArena *arena)
+{
+  for (int i = 0; arena != NULL && i < count; ++(i))
+  {
+    TOMLArena_absorb(arena, &(WORKER(workers, size, i)->arena));
+  }
+}
+
+static void rehome_value(TOMLValue *, TOMLArena *);
+
+/*
+ * @brief Points the items of `array`, and the ones nested in them, at
+ *        `arena`.
+ */
+static void rehome_array(TOMLArray array, TOMLArena *arena)
+{
+  TOMLArray_header(array)->arena = arena;
+  for (int i = 0; i < TOMLArray_len(array); ++(i))
+  {
+    rehome_value(&(array[i]), arena);
+  }
+}
+
+/*
+ * @brief Points `value`, if it's a container, and the ones nested in it at
+ *        `arena`.
+ */
+static void rehome_value(TOMLValue *value, TOMLArena *arena)
+{
+  if (value->kind == TOML_TABLE || value->kind == TOML_INLINE_TABLE)
+  {
+    TOML_pool_rehome(value->table, arena);
+  } else if (value->kind == TOML_ARRAY || value->kind == TOML_TABLE_ARRAY)
+  {
+    rehome_array(value->array, arena);
+  } else if (value->kind == TOML_PACKED_ARRAY)
+  {
+    value->packed->arena = arena;
+  }
+}
+
+/**
+ * @brief Points `table`, which lives in an arena, and every table and array
+ *        nested in it at `arena`.
+ */
+void TOML_pool_rehome(TOMLTable table, TOMLArena *arena)
+{
+  TOMLTable_Header *const hdr = TOMLTable_header(table);
+  if (hdr->arena == NULL)
+  {
+    return;
+  }
+  hdr->arena = arena;
+  for (int i = 0; i < hdr->len; ++(i))
+  {
+    if (table[i].key != NULL)
+    {
+      rehome_value(&(hdr->values[i]), arena);
+    }
+  }
+}
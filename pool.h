@@ -0,0 +1,29 @@
+/*
+ * @file pool.h
+ * @brief The thread pool shared by the parsers that run on several threads.
+ */
+
+#ifndef C_TOML_POOL_H
+#define C_TOML_POOL_H
+#include <pthread.h>
+#include <stddef.h>
+#include "lib.h"
+
+/**
+ * @struct TOMLPool_Worker
+ * @brief The part of a worker the pool takes care of, which the worker
+ *        structs of the users of the pool start with.
+ */
+typedef struct TOMLPool_Worker {
+  TOMLArena  arena;  ///< Where the worker allocates, if the results go in
+                     ///< an arena.
+  pthread_t  thread;
+} TOMLPool_Worker;
+
+int  TOML_pool_threads(int, int);
+void TOML_pool_run    (void *, size_t, int, TOMLArena const *,
+                       void *(*)(void *));
+void TOML_pool_finish (void *, size_t, int, TOMLArena *);
+void TOML_pool_rehome (TOMLTable, TOMLArena *);
+
+#endif /* C_TOML_POOL_H */
@@ -0,0 +1,214 @@
+/*
+ * @file reload.c
+ * @brief Swapping the snapshot of a configuration while threads read it.
+ *
+ * This is epoch-based reclamation. A reader stores the current epoch in its
+ * slot before loading the current snapshot, and the publisher swaps the
+ * snapshot before starting the next epoch, all sequentially consistent. So
+ * a reader whose slot the publisher doesn't see yet, or sees holding the new
+ * epoch, can only load the new snapshot, and the old one is safe to release
+ * once every slot is either empty or at the new epoch or later.
+ */
+
+#include <stdlib.h>
+#include <sched.h>
+#include "lib.h"
+#include "reload.h"
+
+/**
+ * @brief Initializes `reload` with `snap` as the current snapshot, taking
+ *        over the reference the caller holds to it.
+ * @param snap The first snapshot, or `NULL` if there's none yet.
+ */
+void TOMLReload_init(TOMLReload *reload, TOMLSnapshot *snap)
+{
+  reload->current = snap;
+  reload->epoch = 1;
+  reload->readers = NULL;
+  reload->retired = NULL;
+  pthread_mutex_init(&(reload->lock), NULL);
+}
+
+/**
+ * @brief Adds `reader` to the readers of `reload`, it has to be registered
+ *        before the thread can enter.
+ */
+void TOMLReload_register(TOMLReload *reload, TOMLReload_Reader *reader)
+{
+  reader->epoch = 0;
+  pthread_mutex_lock(&(reload->lock));
+  reader->next = reload->readers;
+  reload->readers = reader;
+  pthread_mutex_unlock(&(reload->lock));
+}
+
+/**
+ * @brief Removes `reader`, which isn't reading, from the readers of
+ *        `reload`.
+ */
+void TOMLReload_unregister(TOMLReload *reload, TOMLReload_Reader *reader)
+{
+  pthread_mutex_lock(&(reload->lock));
+  TOMLReload_Reader **link = &(reload->readers);
+  for (; *link != NULL && *link != reader; link = &((*link)->next)) {}
+  if (*link != NULL)
+  {
+    *link = reader->next;
+  }
+  pthread_mutex_unlock(&(reload->lock));
+}
+
+/**
+ * @brief Starts reading, marking the thread of `reader` as reading in the
+ *        current epoch.
+ * @returns The current snapshot, which stays valid until
+ *          @link TOMLReload_leave @endlink, `NULL` if there's none.
+ *
+ * Reads can't be nested. A thread that needs the snapshot for longer takes a
+ * reference with @link TOMLSnapshot_retain @endlink before leaving.
+ */
+TOMLSnapshot *TOMLReload_enter(TOMLReload *reload, TOMLReload_Reader *reader)
+{
+  __atomic_store_n(&(reader->epoch),
+                   __atomic_load_n(&(reload->epoch), __ATOMIC_SEQ_CST),
+                   __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&(reload->current), __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Stops reading, the snapshot returned by
+ *        @link TOMLReload_enter @endlink can't be used anymore.
+ */
+void TOMLReload_leave(TOMLReload_Reader *reader)
+{
+  __atomic_store_n(&(reader->epoch), 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * @brief Finds the oldest epoch a thread is reading in, with the lock held.
+ * @returns The current epoch if no thread is reading in an older one.
+ */
+static uint64_t oldest_epoch(TOMLReload *reload)
+{
+  uint64_t oldest = __atomic_load_n(&(reload->epoch), __ATOMIC_SEQ_CST);
+  for (TOMLReload_Reader *reader = reload->readers; reader != NULL;
+       reader = reader->next)
+  {
+    uint64_t const epoch = __atomic_load_n(&(reader->epoch),
+                                           __ATOMIC_SEQ_CST);
+    if (epoch != 0 && epoch < oldest)
+    {
+      oldest = epoch;
+    }
+  }
+  return oldest;
+}
+
+/*
+ * @brief Releases the retired snapshots no reader can see anymore, with the
+ *        lock held.
+ * @returns How many are still waiting.
+ */
+static int collect(TOMLReload *reload)
+{
+  uint64_t const oldest = oldest_epoch(reload);
+  int pending = 0;
+  TOMLReload_Retired **link = &(reload->retired);
+  while (*link != NULL)
+  {
+    TOMLReload_Retired *const retired = *link;
+    if (retired->epoch <= oldest)
+    {
+      *link = retired->next;
+      TOMLSnapshot_release(retired->snap);
+      free(retired);
+    } else
+    {
+      ++(pending);
+      link = &(retired->next);
+    }
+  }
+  return pending;
+}
+
+/**
+ * @brief Makes `snap` the current snapshot, taking over the reference the
+ *        caller holds to it, and retires the one it replaces.
+ *
+ * Readers that entered before see the old snapshot until they leave,
+ * readers that enter afterwards see `snap`. If there's no memory to keep
+ * track of the old snapshot, this waits for its readers to leave instead.
+ */
+void TOMLReload_publish(TOMLReload *reload, TOMLSnapshot *snap)
+{
+  pthread_mutex_lock(&(reload->lock));
+  TOMLSnapshot *const old = __atomic_exchange_n(&(reload->current), snap,
+                                                __ATOMIC_SEQ_CST);
+  uint64_t const epoch = __atomic_add_fetch(&(reload->epoch), 1,
+                                            __ATOMIC_SEQ_CST);
+  TOMLReload_Retired *retired = old == NULL ? NULL :
+                                malloc(sizeof(TOMLReload_Retired));
+  if (retired != NULL)
+  {
+    *retired = (TOMLReload_Retired) { old, epoch, reload->retired };
+    reload->retired = retired;
+  } else if (old != NULL)
+  {
+    while (oldest_epoch(reload) < epoch)
+    {
+      sched_yield();
+    }
+    TOMLSnapshot_release(old);
+  }
+  collect(reload);
+  pthread_mutex_unlock(&(reload->lock));
+}
+
+/**
+ * @brief Parses the file at `path` into a snapshot, like
+ *        @link TOMLSnapshot_parse_file @endlink, and publishes it.
+ * @returns The status of parsing, in which case the current snapshot stays.
+ */
+TOMLStatus TOMLReload_parse_file(TOMLReload *reload, TOMLCtx *ctx,
+                                 char const *path, int flags,
+                                 TOMLInterner *keys)
+{
+  TOMLSnapshot *snap;
+  TOMLStatus const status = TOMLSnapshot_parse_file(&(snap), ctx, path,
+                                                    flags, keys);
+  if (status == TOML_E_OK)
+  {
+    TOMLReload_publish(reload, snap);
+  }
+  return status;
+}
+
+/**
+ * @brief Releases the retired snapshots whose readers have all left.
+ * @returns How many are still waiting for readers.
+ */
+int TOMLReload_collect(TOMLReload *reload)
+{
+  pthread_mutex_lock(&(reload->lock));
+  int const pending = collect(reload);
+  pthread_mutex_unlock(&(reload->lock));
+  return pending;
+}
+
+/**
+ * @brief Releases the current snapshot and the retired ones, once no thread
+ *        reads from `reload` anymore.
+ */
+void TOMLReload_destroy(TOMLReload *reload)
+{
+  while (reload->retired != NULL)
+  {
+    TOMLReload_Retired *const retired = reload->retired;
+    reload->retired = retired->next;
+    TOMLSnapshot_release(retired->snap);
+    free(retired);
+  }
+  TOMLSnapshot_release(reload->current);
+  reload->current = NULL;
+  pthread_mutex_destroy(&(reload->lock));
+}
@@ -0,0 +1,76 @@
+/*
+ * @file reload.h
+ * @brief Swapping the snapshot of a configuration while threads read it.
+ */
+
+#ifndef C_TOML_RELOAD_H
+#define C_TOML_RELOAD_H
+#include <pthread.h>
+#include <stdint.h>
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+
+typedef struct TOMLReload         TOMLReload;
+typedef struct TOMLReload_Reader  TOMLReload_Reader;
+typedef struct TOMLReload_Retired TOMLReload_Retired;
+
+/**
+ * @struct TOMLReload_Reader
+ * @brief What a reading thread registers with a @link TOMLReload @endlink,
+ *        one per thread.
+ */
+struct TOMLReload_Reader {
+  uint64_t           epoch; ///< The epoch the thread started reading in,
+                            ///< `0` while it isn't reading.
+  TOMLReload_Reader *next;
+};
+
+/**
+ * @struct TOMLReload_Retired
+ * @brief A snapshot that was replaced, waiting for its readers to leave.
+ */
+struct TOMLReload_Retired {
+  TOMLSnapshot       *snap;
+  uint64_t            epoch; ///< The epoch that started once it was replaced.
+  TOMLReload_Retired *next;
+};
+
+/**
+ * @struct TOMLReload
+ * @brief The current @link TOMLSnapshot @endlink of a configuration, which
+ *        can be replaced while other threads read it.
+ *
+ * Readers bracket their reads with @link TOMLReload_enter @endlink, which
+ * marks the thread as reading in the current epoch and then loads the
+ * current snapshot, and @link TOMLReload_leave @endlink. Neither locks or
+ * touches the reference count of the snapshot.
+ *
+ * @link TOMLReload_publish @endlink swaps the new snapshot in and starts a
+ * new epoch. The old snapshot is retired: it is released once no thread is
+ * reading in an epoch older than the new one, which is checked every time a
+ * snapshot is published and by @link TOMLReload_collect @endlink. Parsing
+ * the new version, with @link TOMLReload_parse_file @endlink for example,
+ * happens entirely on the publishing thread while readers keep going.
+ */
+struct TOMLReload {
+  TOMLSnapshot       *current;
+  uint64_t            epoch;   ///< The current epoch, starting at `1`.
+  TOMLReload_Reader  *readers;
+  TOMLReload_Retired *retired;
+  pthread_mutex_t     lock;    ///< Held while publishing, collecting and
+                               ///< (un)registering readers.
+};
+
+void          TOMLReload_init      (TOMLReload *, TOMLSnapshot *);
+void          TOMLReload_register  (TOMLReload *, TOMLReload_Reader *);
+void          TOMLReload_unregister(TOMLReload *, TOMLReload_Reader *);
+TOMLSnapshot *TOMLReload_enter     (TOMLReload *, TOMLReload_Reader *);
+void          TOMLReload_leave     (TOMLReload_Reader *);
+void          TOMLReload_publish   (TOMLReload *, TOMLSnapshot *);
+TOMLStatus    TOMLReload_parse_file(TOMLReload *, TOMLCtx *, char const *,
+                                    int, TOMLInterner *);
+int           TOMLReload_collect   (TOMLReload *);
+void          TOMLReload_destroy   (TOMLReload *);
+
+#endif /* C_TOML_RELOAD_H */
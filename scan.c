@@ -0,0 +1,175 @@
+/*
+ * @file scan.c
+ * @brief Vectorised scanning kernels used by the parser.
+ */
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+#define is_stop(c, a, b) ((c) == (a) || (c) == (b) || (unsigned char)(c) < 0x20)
+// Calls `X` with every byte that TOML_scan_structural looks for.
+#define STRUCTURAL(X)                                                   \
+  X('[') X(']') X('{') X('}') X('=') X(',') X('.') X('"') X('\'')       \
+  X('#') X('\\') X('\n')
+
+typedef char const *(*ScanFn)(char const *, char const *, char, char);
+typedef uint64_t (*StructuralFn)(char const *);
+
+static char const *scan_scalar(char const *ptr, char const *end,
+                               char a, char b)
+{
+  for (; ptr < end && !is_stop(*ptr, a, b); ++(ptr)) {}
+  return ptr;
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static char const *scan_sse2(char const *ptr, char const *end,
+                             char a, char b)
+{
+  __m128i const va = _mm_set1_epi8(a);
+  __m128i const vb = _mm_set1_epi8(b);
+  __m128i const vctl = _mm_set1_epi8(0x1f);
+  for (; ptr + 16 <= end; ptr += 16)
+  {
+    __m128i const v = _mm_loadu_si128((__m128i const *)ptr);
+    // max(v, 0x1f) == 0x1f only for the bytes <= 0x1f
+    __m128i const hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+        _mm_cmpeq_epi8(_mm_max_epu8(v, vctl), vctl)
+    );
+    int const mask = _mm_movemask_epi8(hits);
+    if (mask != 0)
+    {
+      return ptr + __builtin_ctz(mask);
+    }
+  }
+  return scan_scalar(ptr, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static char const *scan_avx2(char const *ptr, char const *end,
+                             char a, char b)
+{
+  __m256i const va = _mm256_set1_epi8(a);
+  __m256i const vb = _mm256_set1_epi8(b);
+  __m256i const vctl = _mm256_set1_epi8(0x1f);
+  for (; ptr + 32 <= end; ptr += 32)
+  {
+    __m256i const v = _mm256_loadu_si256((__m256i const *)ptr);
+    __m256i const hits = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)),
+        _mm256_cmpeq_epi8(_mm256_max_epu8(v, vctl), vctl)
+    );
+    unsigned const mask = (unsigned)_mm256_movemask_epi8(hits);
+    if (mask != 0)
+    {
+      return ptr + __builtin_ctz(mask);
+    }
+  }
+  return scan_sse2(ptr, end, a, b);
+}
+#endif
+
+static uint64_t structural_scalar(char const *block)
+{
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; ++(i))
+  {
+    switch (block[i])
+    {
+#define X(c) case c:
+      STRUCTURAL(X)
+#undef X
+      {
+        mask |= UINT64_C(1) << i;
+      } break;
+    }
+  }
+  return mask;
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static uint64_t structural_sse2(char const *block)
+{
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; i += 16)
+  {
+    __m128i const v = _mm_loadu_si128((__m128i const *)(block + i));
+    __m128i hits = _mm_setzero_si128();
+#define X(c) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+    STRUCTURAL(X)
+#undef X
+    mask |= (uint64_t)(unsigned)_mm_movemask_epi8(hits) << i;
+  }
+  return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t structural_avx2(char const *block)
+{
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; i += 32)
+  {
+    __m256i const v = _mm256_loadu_si256((__m256i const *)(block + i));
+    __m256i hits = _mm256_setzero_si256();
+#define X(c)                                                            \
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+    STRUCTURAL(X)
+#undef X
+    mask |= (uint64_t)(unsigned)_mm256_movemask_epi8(hits) << i;
+  }
+  return mask;
+}
+#endif
+
+static char const *scan_dispatch(char const *, char const *, char, char);
+static uint64_t structural_dispatch(char const *);
+
+// Resolved on the first call. Racing threads all store the same pointer,
+// atomically so that none of them can see half of another's. The functions
+// only depend on the CPU, so no ordering is needed.
+static ScanFn scan_impl = scan_dispatch;
+static StructuralFn structural_impl = structural_dispatch;
+
+static char const *scan_dispatch(char const *ptr, char const *end,
+                                 char a, char b)
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+  ScanFn const impl = __builtin_cpu_supports("avx2") ? scan_avx2 : scan_sse2;
+#else
+  ScanFn const impl = scan_scalar;
+#endif
+  __atomic_store_n(&(scan_impl), impl, __ATOMIC_RELAXED);
+  return impl(ptr, end, a, b);
+}
+
+char const *TOML_scan_string(char const *ptr, char const *end,
+                             char a, char b)
+{
+  return __atomic_load_n(&(scan_impl), __ATOMIC_RELAXED)(ptr, end, a, b);
+}
+
+static uint64_t structural_dispatch(char const *block)
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+  StructuralFn const impl = __builtin_cpu_supports("avx2") ? structural_avx2 :
+                                                             structural_sse2;
+#else
+  StructuralFn const impl = structural_scalar;
+#endif
+  __atomic_store_n(&(structural_impl), impl, __ATOMIC_RELAXED);
+  return impl(block);
+}
+
+uint64_t TOML_scan_structural(char const *block)
+{
+  return __atomic_load_n(&(structural_impl), __ATOMIC_RELAXED)(block);
+}
@@ -0,0 +1,28 @@
+/*
+ * @file scan.h
+ * @brief Vectorised scanning kernels used by the parser.
+ */
+
+#ifndef C_TOML_SCAN_H
+#define C_TOML_SCAN_H
+#include <stdint.h>
+
+/**
+ * @fn TOML_scan_string(char const *ptr, char const *end, char a, char b)
+ * @brief Finds the first byte in [`ptr`, `end`) that is either `a`, `b` or a
+ *        control character (`0x00` to `0x1f`).
+ * @returns The address of that byte, or `end` if there is none.
+ *
+ * The SSE2 or AVX2 kernel is picked at runtime on x86, the other platforms
+ * use the scalar one.
+ */
+char const *TOML_scan_string(char const *, char const *, char, char);
+/**
+ * @fn TOML_scan_structural(char const *block)
+ * @brief Classifies the 64 bytes at `block`.
+ * @returns A mask with bit `i` set if `block[i]` is one of
+ *          `[ ] { } = , . " ' # \` or a newline.
+ */
+uint64_t TOML_scan_structural(char const *);
+
+#endif /* C_TOML_SCAN_H */
@@ -6,7 +6,6 @@ mkdir -p cake_libs/
 current_dir=`pwd`
 cd cake_libs
 git clone https://github.com/fabriciopashaj/c-string
-git clone https://github.com/fabriciopashaj/c-vector
 git clone https://github.com/fabriciopashaj/c-ansi-sequences
 
 cd $current_dir
@@ -0,0 +1,125 @@
+/*
+ * @file snapshot.c
+ * @brief Immutable documents shared between threads.
+ */
+
+#include <stdlib.h>
+#include "lib.h"
+
+/*
+ * @brief Allocates a snapshot with a single reference and an empty arena.
+ */
+static TOMLSnapshot *snapshot_alloc(size_t block_size)
+{
+  TOMLSnapshot *snap = malloc(sizeof(TOMLSnapshot));
+  if (snap != NULL)
+  {
+    snap->root = NULL;
+    TOMLArena_init(&(snap->arena), block_size);
+    snap->refs = 1;
+  }
+  return snap;
+}
+
+/**
+ * @brief Freezes `*table_p` and makes a snapshot of it, with a single
+ *        reference held by the caller.
+ * @param arena The arena the table lives in, or `NULL` if it's on the heap.
+ *              Its blocks are handed over to the snapshot and it is left
+ *              empty.
+ * @returns @link TOML_E_OOM @endlink if the system is out of memory or the
+ *          table couldn't be frozen, in which case neither the table nor the
+ *          arena is taken.
+ *
+ * On success `*table_p` is set to `NULL`, the table belongs to the snapshot.
+ * Strings borrowed from the parsed content still have to outlive it.
+ */
+TOMLStatus TOMLSnapshot_new(TOMLSnapshot **snap_p, TOMLTable *table_p,
+                            TOMLArena *arena)
+{
+  TOMLSnapshot *snap = snapshot_alloc(arena == NULL ? 0 : arena->block_size);
+  if (snap == NULL || TOMLTable_freeze(table_p) != 0)
+  {
+    free(snap);
+    return TOML_E_OOM;
+  }
+  if (arena != NULL)
+  {
+    TOMLArena_absorb(&(snap->arena), arena);
+  }
+  snap->root = *table_p;
+  *table_p = NULL;
+  *snap_p = snap;
+  return TOML_E_OK;
+}
+
+/**
+ * @brief Parses the file at `path` into the arena of a new snapshot, like
+ *        @link TOML_parse_file @endlink, and freezes it.
+ * @param flags The `TOML_F_*` flags to parse with, but
+ *              @link TOML_F_ZERO_COPY @endlink. The strings are always
+ *              copied into the arena of the snapshot, since a mapped file
+ *              that is written to changes under the readers, and one that
+ *              shrinks makes them fault.
+ * @param keys The interner to put the keys through while parsing, or
+ *             `NULL`. Freezing copies the keys into the tables, so the
+ *             snapshot doesn't need the interner afterwards.
+ *
+ * If parsing fails, `ctx` keeps the mapping so that
+ * @link TOML_position @endlink can locate the error, and it has to be
+ * released with @link TOML_unmap @endlink.
+ */
+TOMLStatus TOMLSnapshot_parse_file(TOMLSnapshot **snap_p, TOMLCtx *ctx,
+                                   char const *path, int flags,
+                                   TOMLInterner *keys)
+{
+  TOMLStatus status = TOML_E_OK;
+  TOMLSnapshot *snap = snapshot_alloc(0);
+  if (snap == NULL || (snap->root = TOMLTable_new_in(&(snap->arena))) == NULL)
+  {
+    status = TOML_E_OOM;
+  } else if ((status = TOML_parse_file(ctx, path, &(snap->arena),
+                                       flags & ~TOML_F_ZERO_COPY, keys,
+                                       &(snap->root))) == TOML_E_OK &&
+             TOMLTable_freeze(&(snap->root)) != 0)
+  {
+    status = TOML_E_OOM;
+  }
+  if (status == TOML_E_OK)
+  {
+    TOML_unmap(ctx);
+    *snap_p = snap;
+  } else if (snap != NULL)
+  {
+    TOMLArena_destroy(&(snap->arena));
+    free(snap);
+  }
+  return status;
+}
+
+/**
+ * @brief Takes another reference to `snap`, which is safe to do from any
+ *        thread that already holds one.
+ * @returns `snap`.
+ */
+TOMLSnapshot *TOMLSnapshot_retain(TOMLSnapshot *snap)
+{
+  __atomic_add_fetch(&(snap->refs), 1, __ATOMIC_RELAXED);
+  return snap;
+}
+
+/**
+ * @brief Drops a reference to `snap`, freeing it along with its tree once
+ *        there are none left.
+ */
+void TOMLSnapshot_release(TOMLSnapshot *snap)
+{
+  if (snap == NULL ||
+      __atomic_sub_fetch(&(snap->refs), 1, __ATOMIC_ACQ_REL) != 0)
+  {
+    return;
+  }
+  TOMLTable_destroy(snap->root);
+  TOMLArena_destroy(&(snap->arena));
+  free(snap);
+}
@@ -0,0 +1,44 @@
+/*
+ * @file snapshot.h
+ * @brief Immutable documents shared between threads.
+ */
+
+#ifndef C_TOML_SNAPSHOT_H
+#define C_TOML_SNAPSHOT_H
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+
+typedef struct TOMLSnapshot TOMLSnapshot;
+
+/**
+ * @struct TOMLSnapshot
+ * @brief A parsed document that can't change anymore, which any number of
+ *        threads can read at once without locking.
+ *
+ * Its tables are frozen, so keys can't be put into them or removed from them,
+ * and looking a key up never writes to a table. The snapshot owns the tree
+ * and the arena it lives in, and frees them when the last reference to it is
+ * released. Every thread that holds on to it takes a reference of its own
+ * with @link TOMLSnapshot_retain @endlink.
+ *
+ * Unlike a @link TOMLDoc @endlink, whose lookups decode values in place, a
+ * snapshot is decoded whole before anyone can read it.
+ */
+struct TOMLSnapshot {
+  TOMLTable  root;
+  TOMLArena  arena;   ///< Where the tree lives, if it was parsed into an
+                      ///< arena.
+  int        refs;
+};
+
+TOMLStatus    TOMLSnapshot_new       (TOMLSnapshot **, TOMLTable *,
+                                      TOMLArena *);
+TOMLStatus    TOMLSnapshot_parse_file(TOMLSnapshot **, TOMLCtx *,
+                                      char const *, int, TOMLInterner *);
+TOMLSnapshot *TOMLSnapshot_retain    (TOMLSnapshot *);
+void          TOMLSnapshot_release   (TOMLSnapshot *);
+/// The root table of the snapshot `s`.
+#define TOMLSnapshot_root(s) ((TOMLTable)(s)->root)
+
+#endif /* C_TOML_SNAPSHOT_H */
@@ -0,0 +1,175 @@
+/*
+ * @file split.c
+ * @brief The top-level section scanner.
+ */
+
+#include <string.h>
+#include "split.h"
+#include "scan.h"
+
+/*
+ * @brief Skips a run of quotes inside a multi-line string, which closes it
+ *        if it is 3 to 5 quotes long (up to two of them being content).
+ * @returns `NULL` if the run reaches `end` and more bytes may follow.
+ */
+static char const *ml_quotes(
+  TOMLSplitter *sp, char const *ptr, char const *end, int final
+)
+{
+  char const quote = *ptr;
+  int run = 0;
+  for (; ptr + run < end && ptr[run] == quote && run < 5; ++(run)) {}
+  if (ptr + run == end && run < 5 && !final)
+  {
+    return NULL;
+  }
+  if (run >= 3)
+  {
+    sp->state = TOML_SPLIT_NORMAL;
+  }
+  return ptr + run;
+}
+
+size_t TOML_split(
+  TOMLSplitter *sp, char const *ptr, size_t len, int final, int *header_p
+)
+{
+  char const *p = ptr;
+  char const *const end = ptr + len;
+  *header_p = 0;
+  while (p < end)
+  {
+    switch (sp->state)
+    {
+      case TOML_SPLIT_NORMAL:
+      {
+        char const c = *p;
+        if (c == '\n')
+        {
+          sp->line_start = 1;
+          sp->header = 0;
+          ++(p);
+          break;
+        } else if (c == ' ' || c == '\t' || c == '\r')
+        {
+          ++(p);
+          break;
+        } else if ((c == '"' || c == '\'') && end - p < 3 && !final)
+        {
+          // Can't tell a multi-line string yet
+          goto out;
+        }
+        int const line_start = sp->line_start;
+        sp->line_start = 0;
+        switch (c)
+        {
+          case '[':
+          {
+            if (line_start && sp->depth == 0)
+            {
+              sp->header = 1;
+              *header_p = 1;
+              ++(p);
+              goto out;
+            }
+          } __attribute__((fallthrough));
+          case '{':
+          {
+            sp->depth += !sp->header;
+          } break;
+          case ']':
+          case '}':
+          {
+            sp->depth -= !sp->header && sp->depth > 0;
+          } break;
+          case '#':
+          {
+            sp->state = TOML_SPLIT_COMMENT;
+          } break;
+          case '"':
+          case '\'':
+          {
+            if (end - p >= 3 && p[1] == c && p[2] == c)
+            {
+              sp->state = c == '"' ? TOML_SPLIT_ML_BASIC :
+                                     TOML_SPLIT_ML_LITERAL;
+              p += 2;
+            } else
+            {
+              sp->state = c == '"' ? TOML_SPLIT_BASIC : TOML_SPLIT_LITERAL;
+            }
+          } break;
+        }
+        ++(p);
+      } break;
+      case TOML_SPLIT_COMMENT:
+      {
+        char const *nl = memchr(p, '\n', end - p);
+        if (nl == NULL)
+        {
+          p = end;
+        } else
+        {
+          sp->state = TOML_SPLIT_NORMAL;
+          p = nl;
+        }
+      } break;
+      case TOML_SPLIT_BASIC:
+      case TOML_SPLIT_LITERAL:
+      {
+        char const quote = sp->state == TOML_SPLIT_BASIC ? '"' : '\'';
+        p = TOML_scan_string(p, end, quote, quote == '"' ? '\\' : quote);
+        if (p == end)
+        {
+          break;
+        } else if (*p == '\\')
+        {
+          if (end - p < 2 && !final)
+          {
+            goto out;
+          }
+          p += 2;
+        } else if (*p == quote || *p == '\n')
+        {
+          // A newline means the string is unterminated, which is left for
+          // the parser to report.
+          sp->state = TOML_SPLIT_NORMAL;
+          p += *p == quote;
+        } else
+        {
+          ++(p);
+        }
+      } break;
+      case TOML_SPLIT_ML_BASIC:
+      case TOML_SPLIT_ML_LITERAL:
+      {
+        char const quote = sp->state == TOML_SPLIT_ML_BASIC ? '"' : '\'';
+        p = TOML_scan_string(p, end, quote, quote == '"' ? '\\' : quote);
+        if (p == end)
+        {
+          break;
+        } else if (*p == '\\')
+        {
+          if (end - p < 2 && !final)
+          {
+            goto out;
+          }
+          p += 2;
+        } else if (*p == quote)
+        {
+          char const *next = ml_quotes(sp, p, end, final);
+          if (next == NULL)
+          {
+            goto out;
+          }
+          p = next;
+        } else
+        {
+          ++(p);
+        }
+      } break;
+    }
+  }
+out:
+  return (p > end ? end : p) - ptr;
+}
@@ -0,0 +1,50 @@
+/*
+ * @file split.h
+ * @brief Finding the top-level sections of a document without parsing it.
+ */
+
+#ifndef C_TOML_SPLIT_H
+#define C_TOML_SPLIT_H
+#include <stddef.h>
+#include <stdint.h>
+
+#define TOML_SPLIT_NORMAL     0
+#define TOML_SPLIT_COMMENT    1
+#define TOML_SPLIT_BASIC      2
+#define TOML_SPLIT_LITERAL    3
+#define TOML_SPLIT_ML_BASIC   4
+#define TOML_SPLIT_ML_LITERAL 5
+
+/**
+ * @struct TOMLSplitter
+ * @brief The state of the section scanner, kept between calls so that a
+ *        document can be scanned in pieces.
+ *
+ * A top-level section starts at a `[` that is the first character of a
+ * line, outside of any string and of any array or inline table value.
+ */
+typedef struct TOMLSplitter {
+  uint8_t state;      ///< One of the `TOML_SPLIT_*` states.
+  uint8_t line_start; ///< Whether only whitespace was seen on the line.
+  uint8_t header;     ///< Whether the line is a table header.
+  int     depth;      ///< The nesting of arrays and inline tables.
+} TOMLSplitter;
+
+#define TOMLSplitter_init(sp)                                       \
+  (*(sp) = (TOMLSplitter) { TOML_SPLIT_NORMAL, 1, 0, 0 })
+
+/**
+ * @fn TOML_split(TOMLSplitter *sp, char const *ptr, size_t len, int final,
+ *                int *header_p)
+ * @brief Scans `len` bytes at `ptr` up to the start of the next top-level
+ *        section.
+ * @param final Whether the bytes are the end of the document. If not, the
+ *              scan stops early at quotes and escapes that need more bytes
+ *              to be told apart.
+ * @param header_p Set to whether the scan stopped at a section, in which
+ *                 case the last byte scanned is its `[`.
+ * @returns The number of bytes scanned, the next call continues from there.
+ */
+size_t TOML_split(TOMLSplitter *, char const *, size_t, int, int *);
+
+#endif /* C_TOML_SPLIT_H */
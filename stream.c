@@ -0,0 +1,179 @@
+/*
+ * @file stream.c
+ * @brief The chunked parser.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+
+#define PADDING 8 // Zero bytes kept after the buffer for the parser to peek at
+
+#define throw(err) { status = TOML_E_##err; goto catch; }
+#define try(thing) { status = (thing); if (status) { goto catch; } }
+
+void TOMLStream_init(
+  TOMLStream *stream, TOMLStream_Callback callback, void *data
+)
+{
+  memset(stream, 0, sizeof(TOMLStream));
+  TOMLSplitter_init(&(stream->splitter));
+  stream->callback = callback;
+  stream->data = data;
+}
+
+static TOMLStatus append(TOMLStream *stream, char const *chunk, size_t len)
+{
+  if (stream->len + len + PADDING > stream->cap)
+  {
+    size_t cap = stream->cap < 4096 ? 4096 : stream->cap;
+    for (; cap < stream->len + len + PADDING; cap *= 2) {}
+    char *buffer = realloc(stream->buffer, cap);
+    if (buffer == NULL)
+    {
+      return TOML_E_OOM;
+    }
+    stream->buffer = buffer;
+    stream->cap = cap;
+  }
+  memcpy(stream->buffer + stream->len, chunk, len);
+  stream->len += len;
+  memset(stream->buffer + stream->len, '\0', PADDING);
+  return TOML_E_OK;
+}
+
+/*
+ * @brief Parses the first `size` bytes of the buffer as a document of its
+ *        own, hands it to the callback and drops them.
+ */
+static TOMLStatus emit(TOMLStream *stream, size_t size)
+{
+  TOMLStatus status = TOML_E_OK;
+  char *const buffer = stream->buffer;
+  TOMLCtx ctx = {
+    .content = buffer,
+    .end = buffer + size,
+    .offset = buffer
+  };
+  TOMLTable table = TOMLTable_new();
+  if (table == NULL)
+  {
+    return TOML_E_OOM;
+  }
+  char const saved = buffer[size];
+  buffer[size] = '\0';
+  status = TOML_parse(&ctx, &table);
+  buffer[size] = saved;
+  if (status != TOML_E_OK)
+  {
+    TOMLPosition position = TOML_position(&ctx);
+    stream->position = (TOMLPosition) {
+      .offset = stream->consumed + position.offset,
+      .line = stream->lines + position.line,
+      .column = position.column
+    };
+    TOMLTable_destroy(table);
+    return status;
+  }
+  for (char const *nl = buffer;
+       (nl = memchr(nl, '\n', buffer + size - nl)) != NULL; ++(nl))
+  {
+    ++(stream->lines);
+  }
+  stream->consumed += size;
+  stream->len -= size;
+  stream->scanned -= size;
+  memmove(buffer, buffer + size, stream->len + PADDING);
+  if (TOMLTable_count(table) == 0)
+  {
+    TOMLTable_destroy(table);
+  } else
+  {
+    status = stream->callback(stream->data, table);
+  }
+  return status;
+}
+
+/*
+ * @brief Emits every section of the buffer that is known to be complete.
+ */
+static TOMLStatus drain(TOMLStream *stream, int final)
+{
+  TOMLStatus status = TOML_E_OK;
+  for (;;)
+  {
+    int header;
+    stream->scanned += TOML_split(
+        &(stream->splitter), stream->buffer + stream->scanned,
+        stream->len - stream->scanned, final, &(header)
+    );
+    if (!header)
+    {
+      break;
+    } else if (stream->scanned > 1)
+    {
+      // The section that was being read ends right before the new header.
+      try(emit(stream, stream->scanned - 1));
+    }
+  }
+  if (stream->limit != 0 && stream->scanned > stream->limit)
+  {
+    throw(SECTION_TOO_BIG);
+  }
+catch:
+  return status;
+}
+
+/**
+ * @brief Feeds the next `len` bytes of the document to the stream, calling
+ *        the callback for each section they complete.
+ * @returns The status of the first section that fails to parse, in which
+ *          case `stream->position` tells where the error is,
+ *          @link TOML_E_SECTION_TOO_BIG @endlink if a section is longer than
+ *          `stream->limit`, or the status returned by the callback.
+ */
+TOMLStatus TOMLStream_feed(TOMLStream *stream, char const *chunk, size_t len)
+{
+  TOMLStatus status = TOML_E_OK;
+  // Buffering the chunk a step at a time keeps big chunks from growing the
+  // carry-over past the section being read.
+  for (size_t step; len > 0; chunk += step, len -= step)
+  {
+    step = len < TOML_STREAM_STEP ? len : TOML_STREAM_STEP;
+    try(append(stream, chunk, step));
+    try(drain(stream, 0));
+  }
+catch:
+  return status;
+}
+
+/**
+ * @brief Tells the stream that the document is over, which emits the last
+ *        section.
+ */
+TOMLStatus TOMLStream_finish(TOMLStream *stream)
+{
+  TOMLStatus status = TOML_E_OK;
+  if (stream->buffer == NULL)
+  {
+    return status;
+  }
+  try(drain(stream, 1));
+  if (stream->len > 0)
+  {
+    try(emit(stream, stream->len));
+  }
+catch:
+  return status;
+}
+
+/**
+ * @brief Frees the buffer of the stream. The tables that were emitted belong
+ *        to the callback and are left alone.
+ */
+void TOMLStream_destroy(TOMLStream *stream)
+{
+  free(stream->buffer);
+  stream->buffer = NULL;
+  stream->len = stream->cap = stream->scanned = 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * @file stream.h
+ * @brief Parsing a document that arrives in chunks.
+ */
+
+#ifndef C_TOML_STREAM_H
+#define C_TOML_STREAM_H
+#include <stddef.h>
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+#include "split.h"
+
+#define TOML_STREAM_STEP (64 * 1024) ///< The most bytes of a chunk that are
+                                     ///< buffered before being scanned.
+
+/**
+ * @brief Receives a top-level section of a stream as soon as it is complete.
+ * @param section A table with the same shape as the document would have if
+ *                it only had that section, the callback owns it.
+ * @returns Anything but @link TOML_E_OK @endlink stops the stream, which
+ *          returns the same status.
+ */
+typedef TOMLStatus (*TOMLStream_Callback)(void *, TOMLTable);
+
+typedef struct TOMLStream TOMLStream;
+
+/**
+ * @struct TOMLStream
+ * @brief A resumable parser that is fed a document in chunks.
+ *
+ * The stream only keeps the section it hasn't seen the end of yet, plus at
+ * most @link TOML_STREAM_STEP @endlink bytes that haven't been scanned, so
+ * memory use depends on the biggest section instead of the document. The
+ * sections are parsed separately, which means that keys and tables defined
+ * again in a later section aren't reported as duplicates. Strings are always
+ * copied, since the buffer is reused.
+ */
+struct TOMLStream {
+  TOMLSplitter         splitter;
+  char                *buffer;   ///< The carry-over, starting at the section
+                                 ///< being read.
+  size_t               len;
+  size_t               cap;
+  size_t               scanned;  ///< How much of `buffer` has been split.
+  size_t               limit;    ///< The most bytes a section can have, `0`
+                                 ///< for no limit.
+  size_t               consumed; ///< The bytes of the sections emitted.
+  int                  lines;    ///< The lines of the sections emitted.
+  TOMLStream_Callback  callback;
+  void                *data;     ///< Passed to `callback`.
+  TOMLPosition         position; ///< Where the last parsing error is, from
+                                 ///< the start of the stream.
+};
+
+void       TOMLStream_init   (TOMLStream *, TOMLStream_Callback, void *);
+TOMLStatus TOMLStream_feed   (TOMLStream *, char const *, size_t);
+TOMLStatus TOMLStream_finish (TOMLStream *);
+void       TOMLStream_destroy(TOMLStream *);
+
+#endif /* C_TOML_STREAM_H */
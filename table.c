@@ -1,109 +1,649 @@
 #include <string.h>
 #include <malloc.h>
-#include <xxhash.h>
+#include "hash.h"
 #include "table.h"
 
-TOMLTable TOMLTable_with_size(int count)
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP        TOML_TABLE_GROUP
+#ifdef TOML_TABLE_ROBIN_HOOD
+#define CTRL_EMPTY   0
+#define RH_MAX_PROBE 128 // Past this, inserting grows the table instead
+#define dist(hdr, i) (((uint8_t *)(hdr)->ctrl)[i])
+#else
+#define CTRL_EMPTY   ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+#endif
+// The hash picks the first slot to probe with its high bits and tells the
+// keys in a group apart with its low 7 bits.
+#define h1(hash) ((hash) >> 7)
+#define h2(hash) ((int8_t)((hash) & 0x7f))
+// How many entries an index of `size` slots takes, which keeps it from
+// getting too full even before the removed ones are cleaned up.
+#define max_load(size) ((size) - (size) / 8)
+#define SMALL          TOML_TABLE_SMALL
+// How many entries a table with an index of `size` slots takes, tables
+// without one are small.
+#define capacity(size) ((size) == 0 ? SMALL : max_load(size))
+// The position of the entry the slot `index` of the index points to, small
+// tables are looked up by entry.
+#define entry_of(hdr, index) \
+  ((hdr)->size == 0 ? (index) : (hdr)->slots[index])
+
+static TOMLTable alloc_table(int size, TOMLArena *arena)
 {
-  int size = offsetof(TOMLTable_Header, items) +
-             count * sizeof(TOMLTable_Bucket);
-  TOMLTable_Header *hdr = malloc(size);
-  memset(hdr, '\0', size);
-  TOMLTable hmap = NULL;
-  if (hdr != NULL)
+  int const cap = capacity(size);
+  size_t const bytes = offsetof(TOMLTable_Header, items) +
+                       cap * (sizeof(TOMLTable_Bucket) + sizeof(TOMLValue)) +
+                       (size == 0 ? SMALL * sizeof(uint32_t) :
+                                    size * sizeof(int32_t) + size + GROUP);
+  TOMLTable_Header *hdr = arena == NULL ? malloc(bytes) :
+                                          TOMLArena_alloc(arena, bytes);
+  if (hdr == NULL)
   {
-    hmap = &(hdr->items[0]);
-    hdr->size = count;
+    return NULL;
   }
-  return hmap;
+  memset(hdr, '\0', offsetof(TOMLTable_Header, items));
+  hdr->size = size;
+  hdr->arena = arena;
+  // The values go right after the buckets, which keeps them aligned.
+  hdr->values = (TOMLValue *)&(hdr->items[cap]);
+  if (size == 0)
+  {
+    hdr->tags = (uint32_t *)&(hdr->values[cap]);
+    memset(hdr->tags, '\0', SMALL * sizeof(uint32_t));
+  } else
+  {
+    hdr->slots = (int32_t *)&(hdr->values[cap]);
+    hdr->ctrl = (int8_t *)&(hdr->slots[size]);
+    memset(hdr->ctrl, CTRL_EMPTY, size + GROUP);
+  }
+  return &(hdr->items[0]);
 }
 
-#define TOMLTable_header(m)           \
-  ((TOMLTable_Header *)((void *)(m) - \
-    offsetof(TOMLTable_Header, items)))
+/**
+ * @brief Makes a table with room for `count` keys.
+ */
+TOMLTable TOMLTable_with_size_in(int count, TOMLArena *arena)
+{
+  int size = 0;
+  if (count > SMALL)
+  {
+    for (size = GROUP; max_load(size) < count; size *= 2) {}
+  }
+  return alloc_table(size, arena);
+}
 
-static int TOMLTable_expand(TOMLTable *hmap_p)
+/*
+ * @brief Whether the key of `bucket` is the `len` bytes at `key`, which it
+ *        is right away if they're the same copy, as interned keys are.
+ */
+static int same_key(TOMLTable_Bucket const *bucket, char const *key, int len,
+                    uint32_t hash)
 {
-  int status = 0;
-  TOMLTable_Header *hdr = TOMLTable_header(*hmap_p);
-  int new_size = (hdr->size == 0 ? 2 : hdr->size) * 2;
-  TOMLTable new_map = TOMLTable_with_size(new_size);
-  for (TOMLTable_Bucket *offset = *hmap_p, *end = &((*hmap_p)[hdr->size]);
-       offset < end; ++offset)
+  return bucket->hash == hash && bucket->key_len == len &&
+         (bucket->key == key || memcmp(bucket->key, key, len) == 0);
+}
+
+/*
+ * @brief The tag of a key in a small table: its length and its first three
+ *        bytes, which tells most keys apart without reading them.
+ */
+static uint32_t tag_of(char const *key, int len)
+{
+  uint32_t tag = 0;
+  memcpy(&(tag), key, len < 3 ? len : 3);
+  return tag << 8 | (uint32_t)(len < 0xff ? len : 0xff);
+}
+
+/*
+ * @returns The position of the entry of a small table with the key, `-1` if
+ *          there's none.
+ */
+static int find_small(TOMLTable_Header const *hdr, char const *key, int len)
+{
+  uint32_t const tag = tag_of(key, len);
+  uint32_t hits;
+#ifdef __SSE2__
+  __m128i const needle = _mm_set1_epi32(tag);
+  hits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+             _mm_loadu_si128((__m128i const *)hdr->tags), needle
+         ))) |
+         _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+             _mm_loadu_si128((__m128i const *)(hdr->tags + 4)), needle
+         ))) << 4;
+#else
+  hits = 0;
+  for (int i = 0; i < SMALL; ++(i))
+  {
+    hits |= (uint32_t)(hdr->tags[i] == tag) << i;
+  }
+#endif
+  for (hits &= (1u << hdr->len) - 1; hits != 0; hits &= hits - 1)
+  {
+    TOMLTable_Bucket const *bucket = &(hdr->items[__builtin_ctz(hits)]);
+    if (bucket->key != NULL && bucket->key_len == len &&
+        (bucket->key == key || memcmp(bucket->key, key, len) == 0))
+    {
+      return bucket - hdr->items;
+    }
+  }
+  return -1;
+}
+
+/*
+ * The entries are appended to `items` and `values` in the order their keys
+ * are put, and the index maps the hashes to them. The functions below only
+ * deal with the index, whose slots hold the position of an entry.
+ */
+
+#ifdef TOML_TABLE_ROBIN_HOOD
+
+/*
+ * Robin Hood hashing: the keys are kept in the order of their home slots
+ * along a run, a key taking the slot of one that is closer to its own home.
+ * A byte per slot holds the distance of its key from home plus one, `0`
+ * being a free slot.
+ */
+
+/*
+ * @returns The slot of the index with the key, `-1` if there's none.
+ */
+static int find(TOMLTable_Header const *hdr, char const *key, int len,
+                uint32_t hash)
+{
+  if (hdr->size == 0)
+  {
+    return -1;
+  }
+  size_t const mask = hdr->size - 1;
+  for (size_t i = h1(hash) & mask, d = 0; ; i = (i + 1) & mask, ++(d))
+  {
+    // Past a key that is closer to its home, this one would have been
+    // placed already.
+    if (dist(hdr, i) == 0 || dist(hdr, i) - 1u < d)
+    {
+      return -1;
+    } else if (same_key(&(hdr->items[hdr->slots[i]]), key, len, hash))
+    {
+      return i;
+    }
+  }
+}
+
+/*
+ * @brief Adds the entry at `entry` to the index.
+ * @returns The slot it ends up in, or `-1` if that would push a key further
+ *          than `RH_MAX_PROBE` slots from its home, in which case nothing
+ *          is moved.
+ */
+static int insert(TOMLTable_Header *hdr, int32_t entry, uint32_t hash)
+{
+  size_t const mask = hdr->size - 1;
+  size_t const home = h1(hash) & mask;
+  // A dry run first, following the distance of the key being carried
+  for (size_t i = home, d = 0; dist(hdr, i) != 0; i = (i + 1) & mask, ++(d))
+  {
+    if (dist(hdr, i) - 1u < d)
+    {
+      d = dist(hdr, i) - 1u;
+    }
+    if (d + 1 >= RH_MAX_PROBE)
+    {
+      return -1;
+    }
+  }
+  int placed = -1;
+  for (size_t i = home, d = 0; ; i = (i + 1) & mask, ++(d))
+  {
+    if (d + 1 > (size_t)hdr->max_probe)
+    {
+      hdr->max_probe = d + 1;
+    }
+    if (dist(hdr, i) == 0)
+    {
+      hdr->slots[i] = entry;
+      dist(hdr, i) = d + 1;
+      placed = placed < 0 ? (int)i : placed;
+      break;
+    } else if (dist(hdr, i) - 1u < d)
+    {
+      int32_t const swap = hdr->slots[i];
+      size_t const swap_dist = dist(hdr, i) - 1u;
+      hdr->slots[i] = entry;
+      dist(hdr, i) = d + 1;
+      entry = swap;
+      d = swap_dist;
+      placed = placed < 0 ? (int)i : placed;
+    }
+  }
+  return placed;
+}
+
+/*
+ * @brief Frees the slot at `index` by shifting back the keys after it that
+ *        aren't at home, so no probe sequence is broken.
+ */
+static void erase(TOMLTable_Header *hdr, int index)
+{
+  size_t const mask = hdr->size - 1;
+  size_t i = index;
+  for (size_t next = (i + 1) & mask; dist(hdr, next) > 1;
+       i = next, next = (next + 1) & mask)
+  {
+    hdr->slots[i] = hdr->slots[next];
+    dist(hdr, i) = dist(hdr, next) - 1;
+  }
+  dist(hdr, i) = 0;
+}
+
+#else
+
+typedef uint32_t GroupMask; // A bit per slot of a group
+
+static GroupMask match(int8_t const *group, int8_t byte)
+{
+#ifdef __SSE2__
+  __m128i const ctrl = _mm_loadu_si128((__m128i const *)group);
+  return (GroupMask)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte))
+  );
+#else
+  GroupMask mask = 0;
+  for (int i = 0; i < GROUP; ++(i))
+  {
+    mask |= (GroupMask)(group[i] == byte) << i;
+  }
+  return mask;
+#endif
+}
+
+/*
+ * @brief The slots of the group that are empty or deleted, which are the
+ *        only control bytes with the high bit set.
+ */
+static GroupMask match_free(int8_t const *group)
+{
+#ifdef __SSE2__
+  return (GroupMask)_mm_movemask_epi8(
+      _mm_loadu_si128((__m128i const *)group)
+  );
+#else
+  GroupMask mask = 0;
+  for (int i = 0; i < GROUP; ++(i))
+  {
+    mask |= (GroupMask)(group[i] < 0) << i;
+  }
+  return mask;
+#endif
+}
+
+static void set_ctrl(TOMLTable_Header *hdr, int index, int8_t ctrl)
+{
+  hdr->ctrl[index] = ctrl;
+  if (index < GROUP)
+  {
+    hdr->ctrl[hdr->size + index] = ctrl;
+  }
+}
+
+/*
+ * @returns The slot of the index with the key, `-1` if there's none.
+ */
+static int find(TOMLTable_Header const *hdr, char const *key, int len,
+                uint32_t hash)
+{
+  if (hdr->size == 0)
+  {
+    return -1;
+  }
+  size_t const mask = hdr->size - 1;
+  // The groups are visited with triangular steps, which go through all of
+  // them since their number is a power of two.
+  for (size_t pos = h1(hash) & mask, step = GROUP; ;
+       pos = (pos + step) & mask, step += GROUP)
   {
-    if (offset->key != NULL)
+    int8_t const *const group = hdr->ctrl + pos;
+    for (GroupMask hits = match(group, h2(hash)); hits != 0;
+         hits &= hits - 1)
     {
-      status = TOMLTable_insert(&new_map, offset->key, &(offset->value));
-      if (status != 0)
+      size_t const index = (pos + __builtin_ctz(hits)) & mask;
+      if (same_key(&(hdr->items[hdr->slots[index]]), key, len, hash))
       {
-        TOMLTable_cleanup(new_map);
-        return status;
+        return index;
       }
     }
+    if (match(group, CTRL_EMPTY) != 0)
+    {
+      return -1;
+    }
   }
-  TOMLTable_cleanup(*hmap_p);
-  *hmap_p = new_map;
-  return status;
 }
 
-static TOMLTable_Bucket *get_bucket(TOMLTable hmap, String key,
-                                    uint32_t *hash_p)
+/*
+ * @brief Adds the entry at `entry` to the index, in the first free slot of
+ *        its probe sequence.
+ * @returns The slot it ends up in.
+ */
+static int insert(TOMLTable_Header *hdr, int32_t entry, uint32_t hash)
 {
-  int size = TOMLTable_size(hmap);
-  if (size == 0)
+  size_t const mask = hdr->size - 1;
+  size_t pos = h1(hash) & mask;
+  int probes = 1;
+  GroupMask free_slots;
+  for (size_t step = GROUP; (free_slots = match_free(hdr->ctrl + pos)) == 0;
+       pos = (pos + step) & mask, step += GROUP, ++(probes))
   {
-    return NULL;
   }
-  TOMLTable_Bucket *end = &(hmap[size]);
-  uint32_t hash = XXH32(key, String_len(key), 0);
-  size_t index = hash % size;
-  TOMLTable_Bucket *offset = &(hmap[index]);
-  if (hash_p != NULL)
+  int const index = (pos + __builtin_ctz(free_slots)) & mask;
+  hdr->max_probe = probes > hdr->max_probe ? probes : hdr->max_probe;
+  set_ctrl(hdr, index, h2(hash));
+  hdr->slots[index] = entry;
+  return index;
+}
+
+static void erase(TOMLTable_Header *hdr, int index)
+{
+  // The slot may be in the middle of the probe sequence of other keys, so
+  // it stays taken until the next rehash.
+  set_ctrl(hdr, index, CTRL_DELETED);
+}
+
+#endif
+
+/*
+ * @brief The finalizer of MurmurHash3, which spreads every bit of `hash`
+ *        over the whole word.
+ */
+static uint32_t mix(uint32_t hash)
+{
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+// Maps `hash` to `[0, n)` without a division.
+#define reduce(hash, n) ((uint32_t)(((uint64_t)(hash) * (uint32_t)(n)) >> 32))
+
+#define FREEZE_SALT 0x9e3779b9 // Sets the seed of the second hash of the keys
+                               // of frozen tables apart from the first
+
+/*
+ * @brief The finalizer of the 64-bit MurmurHash3.
+ */
+static uint64_t mix64(uint64_t hash)
+{
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xff51afd7ed558ccd);
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/*
+ * @brief What a frozen table places a key by: the mixed `hash` of the key,
+ *        which picks its bucket, over a second hash of its bytes.
+ *
+ * The slot is picked from all 64 bits, so keys whose 32-bit hashes collide,
+ * which is bound to happen in tables of a hundred thousand keys, can still
+ * be sent to different slots.
+ */
+static uint64_t spread_of(char const *key, int len, uint32_t hash,
+                          uint32_t seed)
+{
+  return ((uint64_t)mix(hash) << 32) | TOML_hash(key, len, seed ^ FREEZE_SALT);
+}
+
+#define bucket_of(spread, n) reduce((uint32_t)((spread) >> 32), n)
+#define slot_of(spread, displace, n) \
+  reduce((uint32_t)(mix64((spread) ^ (displace)) >> 32), n)
+
+/*
+ * @returns The slot of a frozen table with the key, `-1` if there's none.
+ */
+static int find_frozen(TOMLTable_Header const *hdr, char const *key, int len,
+                       uint32_t hash)
+{
+  if (hdr->count == 0)
+  {
+    return -1;
+  }
+  uint64_t const spread = spread_of(key, len, hash, hdr->seed);
+  uint32_t const displace = hdr->displace[bucket_of(spread, hdr->buckets)];
+  int const index = slot_of(spread, displace, hdr->size);
+  return same_key(&(hdr->items[hdr->slots[index]]), key, len, hash) ?
+         index : -1;
+}
+
+/*
+ * @brief Looks the key of `probe` up in whatever way the table is indexed.
+ *        Only the tables with an index need its hash, which is computed
+ *        unless `probe` has it already.
+ * @returns The slot of the index with the key, or the position of its entry
+ *          in a small table, `-1` if there's none.
+ */
+static int lookup(TOMLTable_Header const *hdr, TOMLTable_Bucket *probe)
+{
+  char const *const key = probe->key;
+  int const len = probe->key_len;
+  if (hdr->size == 0)
+  {
+    return find_small(hdr, key, len);
+  } else if (!probe->hashed || hdr->seed != 0)
   {
-    *hash_p = hash;
+    // Frozen tables may have keys hashed with another seed
+    probe->hash = TOML_hash(key, len, hdr->seed);
+    probe->hashed = hdr->seed == 0;
   }
-  for (; offset < end; ++offset)
+  return hdr->frozen ? find_frozen(hdr, key, len, probe->hash) :
+                       find(hdr, key, len, probe->hash);
+}
+
+/*
+ * @brief Appends an entry and indexes it.
+ * @returns The position of the entry, `-1` if the index has no place for it.
+ */
+static int append(TOMLTable_Header *hdr, TOMLTable_Bucket const *bucket,
+                  TOMLValue const *value)
+{
+  int32_t const entry = hdr->len;
+  if (hdr->size == 0)
+  {
+    hdr->tags[entry] = tag_of(bucket->key, bucket->key_len);
+  } else if (insert(hdr, entry, bucket->hash) < 0)
+  {
+    return -1;
+  }
+  hdr->items[entry] = *bucket;
+  hdr->values[entry] = *value;
+  ++(hdr->len);
+  ++(hdr->count);
+  return entry;
+}
+
+/*
+ * @brief Moves the entries to a table at least `min_size` big, twice as big
+ *        as the current one if it's more than half full or to one of the
+ *        same size otherwise, which drops the removed entries. The order of
+ *        the entries and their stored hashes are kept, the keys of a small
+ *        table are hashed when it gets an index.
+ */
+static int TOMLTable_expand(TOMLTable *hmap_p, int min_size)
+{
+  TOMLTable_Header *hdr = TOMLTable_header(*hmap_p);
+  int new_size = hdr->size == 0 ? (hdr->count < SMALL ? 0 : GROUP) :
+                 hdr->count * 2 >= max_load(hdr->size) ? hdr->size * 2 :
+                                                         hdr->size;
+  for (; new_size < min_size; new_size *= 2) {}
+  TOMLTable new_map = alloc_table(new_size, hdr->arena);
+  if (new_map == NULL)
+  {
+    return -1;
+  }
+  TOMLTable_Header *new_hdr = TOMLTable_header(new_map);
+  for (int i = 0; i < hdr->len; ++(i))
   {
-    if (!offset->hash ||
-        (offset->hash == hash && strcmp(key, offset->key) == 0))
+    TOMLTable_Bucket bucket = hdr->items[i];
+    if (bucket.key == NULL)
+    {
+      continue;
+    } else if (!bucket.hashed && new_size != 0)
+    {
+      bucket.hash = TOML_hash(bucket.key, bucket.key_len, new_hdr->seed);
+      bucket.hashed = 1;
+    }
+    if (append(new_hdr, &(bucket), &(hdr->values[i])) < 0)
     {
-      return offset;
+      // Too many colliding keys, a bigger table spreads them out.
+      TOMLTable_cleanup(new_map);
+      return TOMLTable_expand(hmap_p, new_size * 2);
     }
   }
-  return NULL;
+  TOMLTable_cleanup(*hmap_p);
+  *hmap_p = new_map;
+  return 0;
+}
+
+/*
+ * @returns The position of the entry of the key, `-1` if there's none.
+ */
+static int find_key(TOMLTable hmap, char const *key, int len)
+{
+  TOMLTable_Header const *hdr = TOMLTable_header(hmap);
+  TOMLTable_Bucket probe = { .key = (String)key, .key_len = len };
+  int const index = lookup(hdr, &(probe));
+  return index < 0 ? -1 : entry_of(hdr, index);
 }
 
 TOMLValue const *TOMLTable_get(TOMLTable hmap, String key)
 {
-  TOMLTable_Bucket *bucket = get_bucket(hmap, key, NULL);
-  return bucket == NULL || !bucket->value.kind ? NULL : &(bucket->value);
+  int const entry = find_key(hmap, key, String_len(key));
+  return entry < 0 || !TOMLTable_value(hmap, entry)->kind ?
+         NULL : TOMLTable_value(hmap, entry);
 }
 
-TOMLValue *TOMLTable_put_extra(TOMLTable *hmap_p, String key, int store)
+TOMLValue const *TOMLTable_get_view(TOMLTable hmap, TOMLStringView key)
 {
-  TOMLTable_Bucket *bucket = NULL;
-  TOMLValue *val_p = NULL;
-  uint32_t hash;
-  TOMLTable_Header *hdr;
-  do {
-    // TODO: Prevent infinite loop
-    bucket = get_bucket(*hmap_p, key, &hash);
-    hdr = TOMLTable_header(*hmap_p);
-  } while ((bucket == NULL || (hdr->count * 2) > hdr->size) &&
-            TOMLTable_expand(hmap_p) == 0);
-  if (bucket != NULL && (hdr->count * 2) <= hdr->size)
+  int const entry = find_key(hmap, key.data, key.len);
+  return entry < 0 || !TOMLTable_value(hmap, entry)->kind ?
+         NULL : TOMLTable_value(hmap, entry);
+}
+
+/**
+ * @brief Looks up a key whose hash was computed with
+ *        @link TOML_hash @endlink and seed `0`, which is only hashed again
+ *        if the table is frozen.
+ */
+TOMLValue const *TOMLTable_get_hashed(TOMLTable hmap, TOMLStringView key,
+                                      uint32_t hash)
+{
+  TOMLTable_Header const *hdr = TOMLTable_header(hmap);
+  TOMLTable_Bucket probe = {
+    .key = (String)key.data,
+    .hash = hash,
+    .key_len = key.len,
+    .hashed = 1
+  };
+  int const index = lookup(hdr, &(probe));
+  int const entry = index < 0 ? -1 : entry_of(hdr, index);
+  return entry < 0 || !TOMLTable_value(hmap, entry)->kind ?
+         NULL : TOMLTable_value(hmap, entry);
+}
+
+TOMLValue const *TOMLTable_get_key(TOMLTable hmap, TOMLKey const *key)
+{
+  TOMLStringView const view = { .data = key->data, .len = key->len };
+  return TOMLTable_get_hashed(hmap, view, key->hash);
+}
+
+/*
+ * @param bucket The key, whether it's borrowed and its hash if it's known.
+ * @returns The value of the key, which is added with an empty value if it's
+ *          not there and `store` is set, `NULL` if it's not there and
+ *          `store` isn't or if the system is out of memory.
+ */
+static TOMLValue *put(TOMLTable *hmap_p, TOMLTable_Bucket bucket, int store)
+{
+  TOMLTable_Header *hdr = TOMLTable_header(*hmap_p);
+  int const index = lookup(hdr, &(bucket));
+  if (index >= 0)
+  {
+    return &(hdr->values[entry_of(hdr, index)]);
+  } else if (!store || hdr->frozen)
+  {
+    return NULL;
+  }
+  TOMLValue empty;
+  memset(&(empty), '\0', sizeof(TOMLValue));
+  int min_size = 0;
+  int entry;
+  while (hdr->len == capacity(hdr->size) ||
+         (entry = append(hdr, &(bucket), &(empty))) < 0)
   {
-    if (bucket->hash == 0 && store == 1)
+    // A key that can't be placed close enough to home needs more room,
+    // unless the table is already mostly empty and the hashes collide.
+    if (hdr->len != capacity(hdr->size))
+    {
+      if (hdr->size > 16 * hdr->count + GROUP)
+      {
+        return NULL;
+      }
+      min_size = hdr->size * 2;
+    }
+    if (TOMLTable_expand(hmap_p, min_size) != 0)
+    {
+      return NULL;
+    }
+    hdr = TOMLTable_header(*hmap_p);
+    if (!bucket.hashed && hdr->size != 0)
     {
-      bucket->hash = hash;
-      bucket->key = key;
-      ++(hdr->count);
-      bucket->value.float_ = 0;
-      bucket->value.kind = 0;
+      bucket.hash = TOML_hash(bucket.key, bucket.key_len, hdr->seed);
+      bucket.hashed = 1;
     }
-    val_p = &(bucket->value);
   }
-  return val_p;
+  return &(hdr->values[entry]);
+}
+
+TOMLValue *TOMLTable_put_extra(TOMLTable *hmap_p, String key, int store)
+{
+  TOMLTable_Bucket const bucket = { .key = key, .key_len = String_len(key) };
+  return put(hmap_p, bucket, store);
+}
+
+/**
+ * @brief Like @link TOMLTable_put @endlink, but the table borrows the key
+ *        instead of taking ownership of it.
+ */
+TOMLValue *TOMLTable_put_view(TOMLTable *hmap_p, TOMLStringView key)
+{
+  TOMLTable_Bucket const bucket = {
+    .key = (String)key.data,
+    .key_len = key.len,
+    .borrowed = 1
+  };
+  return put(hmap_p, bucket, 1);
+}
+
+/**
+ * @brief Like @link TOMLTable_put_view @endlink, with a key that is already
+ *        hashed, like the ones of a @link TOMLInterner @endlink.
+ */
+TOMLValue *TOMLTable_put_key(TOMLTable *hmap_p, TOMLKey const *key)
+{
+  TOMLTable_Bucket const bucket = {
+    .key = (String)key->data,
+    .hash = key->hash,
+    .key_len = key->len,
+    .borrowed = 1,
+    .hashed = 1
+  };
+  return put(hmap_p, bucket, 1);
 }
 
 int TOMLTable_insert(TOMLTable *hmap_p, String key,
@@ -122,48 +662,332 @@ int TOMLTable_insert(TOMLTable *hmap_p, String key,
 
 int TOMLTable_has_key(TOMLTable hmap, String key)
 {
-  uint32_t hash;
-  TOMLTable_Bucket *bucket = get_bucket(hmap, key, &hash);
-  return bucket != NULL && bucket->hash == hash &&
-         strcmp(key, bucket->key) == 0;
+  return find_key(hmap, key, String_len(key)) >= 0;
+}
+
+/**
+ * @brief Removes `key` from the table, leaving a hole among the entries
+ *        until the table is rehashed.
+ * @param val_p Where to move the value of the key, or `NULL` to destroy it.
+ * @returns `0` on success, `-1` if the key isn't in the table or the table
+ *          is frozen.
+ */
+int TOMLTable_pop_view(TOMLTable hmap, TOMLStringView key, TOMLValue *val_p)
+{
+  TOMLTable_Header *hdr = TOMLTable_header(hmap);
+  if (hdr->frozen)
+  {
+    return -1;
+  }
+  TOMLTable_Bucket probe = { .key = (String)key.data, .key_len = key.len };
+  int const index = lookup(hdr, &(probe));
+  if (index < 0)
+  {
+    return -1;
+  }
+  int const entry = entry_of(hdr, index);
+  TOMLTable_Bucket *bucket = &(hdr->items[entry]);
+  if (val_p != NULL)
+  {
+    *val_p = hdr->values[entry];
+  } else if (hdr->arena == NULL)
+  {
+    TOMLValue_destroy(&(hdr->values[entry]));
+  }
+  if (hdr->arena == NULL && !bucket->borrowed)
+  {
+    String_cleanup(bucket->key);
+  }
+  if (hdr->size == 0)
+  {
+    hdr->tags[entry] = 0;
+  } else
+  {
+    erase(hdr, index);
+  }
+  bucket->key = NULL;
+  --(hdr->count);
+  return 0;
 }
 
 int TOMLTable_pop(TOMLTable hmap, String key, TOMLValue *val_p)
 {
-  int status = 0;
-  uint32_t hash;
-  TOMLTable_Bucket *bucket = get_bucket(hmap, key, &hash);
-  if (bucket != NULL)
+  TOMLStringView const view = { .data = key, .len = String_len(key) };
+  return TOMLTable_pop_view(hmap, view, val_p);
+}
+
+#define MAX_DISPLACE (1 << 20) // Tries per bucket before giving up
+#define FREEZE_SEEDS 8         // Seeds to hash the keys with before giving up
+
+static int freeze_array(TOMLArray array)
+{
+  for (int i = 0; i < TOMLArray_len(array); ++(i))
   {
-    if (val_p != NULL)
+    if ((array[i].kind == TOML_TABLE || array[i].kind == TOML_INLINE_TABLE) &&
+        TOMLTable_freeze(&(array[i].table)) != 0)
+    {
+      return -1;
+    } else if ((array[i].kind == TOML_ARRAY ||
+                array[i].kind == TOML_TABLE_ARRAY) &&
+               freeze_array(array[i].array) != 0)
     {
-      memcpy(val_p, &(bucket->value), sizeof(TOMLValue));
+      return -1;
     }
-    TOMLTable_Bucket *c = bucket + 1;
-    for (TOMLTable_Bucket *end = &(hmap[TOMLTable_header(hmap)->size]);
-         c < end && c->hash && c->hash == hash; ++c);
-    memcpy(bucket, bucket + 1, (int)((void *)c - (void *)bucket));
-    memset(bucket - 1, '\0', sizeof(*bucket));
-  } else
+  }
+  return 0;
+}
+
+/*
+ * @brief Finds a displacement for each bucket of keys, the fullest buckets
+ *        first, that sends them to slots no other key took.
+ * @param spread What each entry is placed by, see `spread_of`.
+ * @returns `0` on success, `-1` if a bucket can't be placed, which happens
+ *          when keys have the same spread, or if the system is out of memory.
+ */
+static int displace(TOMLTable_Header *hdr, uint64_t const *spread)
+{
+  int const n = hdr->count;
+  int status = -1;
+  int *const start = calloc(hdr->buckets + 1, sizeof(int));
+  int *const members = malloc(n * sizeof(int));
+  int *const placed = malloc(n * sizeof(int));
+  uint8_t *const taken = calloc(n, 1);
+  if (start == NULL || members == NULL || placed == NULL || taken == NULL)
+  {
+    goto cleanup;
+  }
+  // The entries of each bucket end up next to each other in `members`.
+  int largest = 0;
+  for (int i = 0; i < n; ++(i))
+  {
+    ++(start[bucket_of(spread[i], hdr->buckets) + 1]);
+  }
+  for (int b = 0; b < hdr->buckets; ++(b))
+  {
+    largest = start[b + 1] > largest ? start[b + 1] : largest;
+    start[b + 1] += start[b];
+  }
+  for (int i = 0; i < n; ++(i))
+  {
+    members[start[bucket_of(spread[i], hdr->buckets)]++] = i;
+  }
+  for (int b = hdr->buckets; b > 0; --(b))
   {
-    status = -1;
+    start[b] = start[b - 1];
   }
+  start[0] = 0;
+  for (int bucket_len = largest; bucket_len > 0; --(bucket_len))
+  {
+    for (int b = 0; b < hdr->buckets; ++(b))
+    {
+      if (start[b + 1] - start[b] != bucket_len)
+      {
+        continue;
+      }
+      int const *const bucket = &(members[start[b]]);
+      for (int j = 0; j < bucket_len; ++(j))
+      {
+        for (int k = 0; k < j; ++(k))
+        {
+          if (spread[bucket[j]] == spread[bucket[k]])
+          {
+            goto cleanup;
+          }
+        }
+      }
+      uint32_t d = 0;
+      for (int j = 0; j < bucket_len; )
+      {
+        if (d == MAX_DISPLACE)
+        {
+          goto cleanup;
+        }
+        int const slot = slot_of(spread[bucket[j]], d, hdr->size);
+        if (taken[slot])
+        {
+          // Back off the slots this try took and move on to the next one
+          while (j > 0)
+          {
+            taken[placed[--(j)]] = 0;
+          }
+          ++(d);
+          continue;
+        }
+        taken[slot] = 1;
+        placed[j++] = slot;
+      }
+      hdr->displace[b] = d;
+      for (int j = 0; j < bucket_len; ++(j))
+      {
+        hdr->slots[placed[j]] = bucket[j];
+      }
+    }
+  }
+  status = 0;
+
+cleanup:
+  free(start);
+  free(members);
+  free(placed);
+  free(taken);
   return status;
 }
 
-void TOMLTable_destroy(TOMLTable table)
+/**
+ * @brief Rebuilds the table, and the tables in it recursively, into a frozen
+ *        one that can only be looked up, through a minimal perfect hash.
+ * @returns `0` on success, `-1` if the system is out of memory or if no
+ *          perfect hash was found, in which case the table is left as it
+ *          was but some tables in it may be frozen already.
+ *
+ * The keys are copied, so the ones borrowed from the parsed content don't
+ * need to outlive the table anymore. A table in an arena is rebuilt in the
+ * same arena.
+ */
+int TOMLTable_freeze(TOMLTable *table_p)
 {
-  int const size = TOMLTable_header(table)->size;
-  int const used = TOMLTable_header(table)->count;
+  TOMLTable_Header *hdr = TOMLTable_header(*table_p);
+  if (hdr->frozen)
+  {
+    return 0;
+  }
+  size_t keys_len = 0;
+  for (int i = 0; i < hdr->len; ++(i))
+  {
+    TOMLValue *value = &(hdr->values[i]);
+    if (hdr->items[i].key == NULL)
+    {
+      continue;
+    } else if ((value->kind == TOML_TABLE ||
+                value->kind == TOML_INLINE_TABLE) &&
+               TOMLTable_freeze(&(value->table)) != 0)
+    {
+      return -1;
+    } else if ((value->kind == TOML_ARRAY ||
+                value->kind == TOML_TABLE_ARRAY) &&
+               freeze_array(value->array) != 0)
+    {
+      return -1;
+    }
+    keys_len += hdr->items[i].key_len;
+  }
+
+  int const n = hdr->count;
+  int const small = n <= SMALL;
+  int const buckets = small ? 0 : n / 4 + 1;
+  size_t const bytes = offsetof(TOMLTable_Header, items) +
+                       n * (sizeof(TOMLTable_Bucket) + sizeof(TOMLValue)) +
+                       (small ? SMALL * sizeof(uint32_t) :
+                                (n + buckets) * sizeof(uint32_t)) +
+                       keys_len;
+  TOMLTable_Header *frozen = hdr->arena == NULL ?
+                             malloc(bytes) :
+                             TOMLArena_alloc(hdr->arena, bytes);
+  uint64_t *spread = malloc((n + 1) * sizeof(uint64_t));
+  if (frozen == NULL || spread == NULL)
+  {
+    // The header isn't set up yet, so it can't tell where it lives.
+    free(spread);
+    free(hdr->arena == NULL ? frozen : NULL);
+    return -1;
+  }
+  memset(frozen, '\0', offsetof(TOMLTable_Header, items));
+  frozen->size = small ? 0 : n;
+  frozen->count = frozen->len = n;
+  frozen->max_probe = !small;
+  frozen->frozen = 1;
+  frozen->buckets = buckets;
+  frozen->arena = hdr->arena;
+  frozen->values = (TOMLValue *)&(frozen->items[n]);
+  if (small)
+  {
+    frozen->tags = (uint32_t *)&(frozen->values[n]);
+    memset(frozen->tags, '\0', SMALL * sizeof(uint32_t));
+  } else
+  {
+    frozen->slots = (int32_t *)&(frozen->values[n]);
+    frozen->displace = (uint32_t *)&(frozen->slots[n]);
+  }
+  char *keys = small ? (char *)&(frozen->tags[SMALL]) :
+                       (char *)&(frozen->displace[buckets]);
+  for (int i = 0, entry = 0; i < hdr->len; ++(i))
+  {
+    TOMLTable_Bucket const *bucket = &(hdr->items[i]);
+    if (bucket->key != NULL)
+    {
+      frozen->items[entry] = *bucket;
+      frozen->items[entry].key = (String)memcpy(keys, bucket->key,
+                                                bucket->key_len);
+      frozen->items[entry].borrowed = 1;
+      frozen->values[entry] = hdr->values[i];
+      if (small)
+      {
+        frozen->tags[entry] = tag_of(keys, bucket->key_len);
+      }
+      spread[entry] = spread_of(keys, bucket->key_len, bucket->hash, 0);
+      keys += bucket->key_len;
+      ++(entry);
+    }
+  }
+  // Keys whose hashes collide can't be told apart by a displacement, but
+  // hashing them with another seed may.
+  while (!small && displace(frozen, spread) != 0)
+  {
+    if (++(frozen->seed) == FREEZE_SEEDS)
+    {
+      free(spread);
+      TOMLTable_cleanup(&(frozen->items[0]));
+      return -1;
+    }
+    for (int i = 0; i < n; ++(i))
+    {
+      TOMLTable_Bucket *bucket = &(frozen->items[i]);
+      bucket->hash = TOML_hash(bucket->key, bucket->key_len, frozen->seed);
+      spread[i] = spread_of(bucket->key, bucket->key_len, bucket->hash,
+                            frozen->seed);
+    }
+  }
+  free(spread);
+
+  // The values moved to the frozen table, only the keys are left to free.
+  if (hdr->arena == NULL)
+  {
+    for (int i = 0; i < hdr->len; ++(i))
+    {
+      if (hdr->items[i].key != NULL && !hdr->items[i].borrowed)
+      {
+        String_cleanup(hdr->items[i].key);
+      }
+    }
+  }
+  TOMLTable_cleanup(*table_p);
+  *table_p = &(frozen->items[0]);
+  return 0;
+}
 
-  for (int i = 0, destroyed = 0; i < size && destroyed < used; ++i)
+/**
+ * @brief Frees the keys and values of the table recursively and the table
+ *        itself.
+ *
+ * Tables that live in an arena are left alone, they are freed along with it.
+ */
+void TOMLTable_destroy(TOMLTable table)
+{
+  TOMLTable_Header *hdr = TOMLTable_header(table);
+  if (hdr->arena != NULL)
+  {
+    return;
+  }
+  for (int i = 0; i < hdr->len; ++i)
   {
     TOMLTable_Bucket *entry = &(table[i]);
     if (entry->key != NULL)
     {
-      ++destroyed;
-      String_cleanup(entry->key);
-      TOMLValue_destroy(&(entry->value));
+      if (!entry->borrowed)
+      {
+        String_cleanup(entry->key);
+      }
+      TOMLValue_destroy(&(hdr->values[i]));
     }
   }
 
@@ -5,39 +5,123 @@
 #include "lib.h"
 #endif
 
+#define TOML_TABLE_GROUP 16 ///< How many control bytes are probed at once.
+#define TOML_TABLE_SMALL 8  ///< How many keys a table holds before it gets
+                            ///< an index.
+
+/**
+ * @struct TOMLTable_Bucket
+ * @brief The key half of an entry of a table, the values are kept in an
+ *        array of their own so that probing only touches keys.
+ *
+ * Buckets are 16 bytes and aligned to that, so four of them share a cache
+ * line and none straddles two.
+ */
 struct TOMLTable_Bucket {
-  TOMLValue value;
-  String    key;
+  String    key;          ///< `NULL` if the entry was removed.
   uint32_t  hash;
-  uint8_t   __padd[sizeof(int) == 4 ? 4 : 0];
-};
+  int       key_len  : 30;
+  unsigned  borrowed : 1; ///< Whether `key` is borrowed from the parsed
+                          ///< content instead of being an owned String.
+  unsigned  hashed   : 1; ///< Whether `hash` is set, keys put in small
+                          ///< tables are hashed once the table gets an
+                          ///< index.
+}__attribute__((aligned(16)));
 
+/**
+ * @struct TOMLTable_Header
+ * @brief The header in front of the entries of a table.
+ *
+ * The entries are kept in the order their keys were put, with holes where
+ * keys were removed until the table is rehashed, so walking the first `len`
+ * of them goes through the keys in document order. The entries are found
+ * through an index of `size` slots, each holding the position of an entry.
+ *
+ * Tables with up to @link TOML_TABLE_SMALL @endlink keys, which are most of
+ * them, have no index and `size` is `0`. Their keys aren't hashed, `tags`
+ * holds the length and the first bytes of each key instead, which are all
+ * compared at once when looking a key up.
+ *
+ * The index is probed a group of @link TOML_TABLE_GROUP @endlink slots at a
+ * time through `ctrl`, which has a byte per slot: the low 7 bits of the hash
+ * of its key if it's used, or a marker for free and deleted slots. The first
+ * group of bytes is repeated past the end so that any group can be loaded
+ * at once.
+ *
+ * Built with `TOML_TABLE_ROBIN_HOOD`, the index uses Robin Hood hashing
+ * instead: slots are probed one at a time, `ctrl` holds how far the key of
+ * each slot is from its home slot plus one (`0` if the slot is free), and
+ * removing a key shifts back the ones after it, so no slot is ever left
+ * marked deleted. Inserting a key that would end up too far from home grows
+ * the table.
+ *
+ * A table made by @link TOMLTable_freeze @endlink can't have keys added or
+ * removed. Its index is a minimal perfect hash: the hash of a key picks one
+ * of `buckets` displacements, which together with the hash picks the only
+ * slot where the key can be, so a lookup never probes. `ctrl` isn't used and
+ * the keys are copied next to each other after the index.
+ *
+ * Looking keys up never writes to a table, so a table that no thread changes
+ * can be read from any number of threads. Putting a key may move the whole
+ * table, see @link TOMLSnapshot @endlink for sharing a document that can't
+ * change.
+ */
 typedef struct TOMLTable_Header {
-  int              size;
+  int              size;      ///< The number of slots of the index, `0` or a
+                              ///< power of two no smaller than a group.
   int              count;
+  int              len;       ///< The number of entries, holes included.
+  int              max_probe; ///< The longest probe sequence an insertion
+                              ///< took, in groups, or in slots with
+                              ///< `TOML_TABLE_ROBIN_HOOD`.
+  int              frozen;
+  uint32_t         seed;      ///< What the keys are hashed with, `0` unless
+                              ///< the table is frozen.
+  int              buckets;   ///< The number of displacements of a frozen
+                              ///< table.
+  TOMLArena       *arena;     ///< The arena the table lives in, `NULL` if
+                              ///< on the heap.
+  uint32_t        *displace;
+  TOMLValue       *values;    ///< The value of each entry.
+  int32_t         *slots;
+  uint32_t        *tags;      ///< The tag of each entry of a small table.
+  int8_t          *ctrl;
   TOMLTable_Bucket items[1];
 } TOMLTable_Header;
 
 // typedef TOMLTable_Bucket *TOMLTable;
 
-TOMLTable TOMLTable_with_size(int);
-#define TOMLTable_new() TOMLTable_with_size(0)
+TOMLTable TOMLTable_with_size_in(int, TOMLArena *);
+#define TOMLTable_with_size(size) TOMLTable_with_size_in(size, NULL)
+#define TOMLTable_new_in(arena) TOMLTable_with_size_in(0, arena)
+#define TOMLTable_new() TOMLTable_new_in(NULL)
 TOMLValue const *TOMLTable_get(TOMLTable, String);
 TOMLValue *TOMLTable_put_extra(TOMLTable *, String, int);
 #define TOMLTable_put(hmap, key) TOMLTable_put_extra(hmap, key, 1)
+TOMLValue const *TOMLTable_get_view(TOMLTable, TOMLStringView);
+TOMLValue const *TOMLTable_get_hashed(TOMLTable, TOMLStringView, uint32_t);
+TOMLValue const *TOMLTable_get_key(TOMLTable, TOMLKey const *);
+TOMLValue *TOMLTable_put_view(TOMLTable *, TOMLStringView);
+TOMLValue *TOMLTable_put_key(TOMLTable *, TOMLKey const *);
 int TOMLTable_insert(TOMLTable *, String, TOMLValue const *);
 int TOMLTable_has_key(TOMLTable, String);
 int TOMLTable_pop(TOMLTable, String, TOMLValue *);
+int TOMLTable_pop_view(TOMLTable, TOMLStringView, TOMLValue *);
+int TOMLTable_freeze(TOMLTable *);
 void TOMLTable_destroy(TOMLTable);
 #define TOMLTable_delete(hmap, key) TOMLTable_pop(hmap, key, NULL)
-#define TOMLTable_cleanup(hmap)                              \
-  free(hmap == NULL ? NULL :                              \
-       ((void *)(hmap) - offsetof(TOMLTable_Header, items)))
-#define TOMLTable_size(t)                                       \
-  (((TOMLTable_Header *)                                        \
-    (((void *)(t)) - offsetof(TOMLTable_Header, items)))->size)
-#define TOMLTable_count(t)                                      \
-  (((TOMLTable_Header *)                                        \
-    (((void *)(t)) - offsetof(TOMLTable_Header, items)))->count)
+#define TOMLTable_header(m)           \
+  ((TOMLTable_Header *)((void *)(m) - \
+    offsetof(TOMLTable_Header, items)))
+#define TOMLTable_cleanup(hmap)                                 \
+  free(hmap == NULL || TOMLTable_header(hmap)->arena != NULL ?  \
+       NULL : TOMLTable_header(hmap))
+#define TOMLTable_size(t) (TOMLTable_header(t)->size)
+#define TOMLTable_count(t) (TOMLTable_header(t)->count)
+#define TOMLTable_len(t) (TOMLTable_header(t)->len)
+#define TOMLTable_frozen(t) (TOMLTable_header(t)->frozen)
+#define TOMLTable_max_probe(t) (TOMLTable_header(t)->max_probe)
+/// The value of the `i`th entry of `t`, which is used if `t[i].key` is set.
+#define TOMLTable_value(t, i) (&(TOMLTable_header(t)->values[i]))
 
 #endif /* __TOML_TOMLTABLE_H__ */
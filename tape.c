@@ -0,0 +1,188 @@
+/*
+ * @file tape.c
+ * @brief The first stage of the two-stage parser, which indexes the
+ *        structural characters of a document.
+ *
+ * The document is classified 64 bytes at a time by
+ * @link TOML_scan_structural @endlink and only the bytes it flags are looked
+ * at one by one, to tell apart the ones inside strings and comments.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "scan.h"
+
+#define TAPE_MAX_CONTENT ((size_t)TOML_TAPE_ESCAPED)
+
+// What the bytes being indexed are part of
+#define IN_NORMAL     0
+#define IN_COMMENT    1
+#define IN_BASIC      2
+#define IN_LITERAL    3
+#define IN_ML_BASIC   4
+#define IN_ML_LITERAL 5
+
+#define throw(err) { status = TOML_E_##err; goto catch; }
+
+static int push(TOMLTape *tape, uint32_t item)
+{
+  if (tape->len == tape->cap)
+  {
+    int const cap = tape->cap < 64 ? 64 : tape->cap * 2;
+    uint32_t *items = realloc(tape->items, cap * sizeof(uint32_t));
+    if (items == NULL)
+    {
+      return -1;
+    }
+    tape->items = items;
+    tape->cap = cap;
+  }
+  tape->items[tape->len++] = item;
+  return 0;
+}
+
+/*
+ * @brief Whether the bytes at `offset` and the two after it are all `quote`.
+ */
+static int triple(char const *content, size_t len, size_t offset, char quote)
+{
+  return offset + 2 < len && content[offset] == quote &&
+         content[offset + 1] == quote && content[offset + 2] == quote;
+}
+
+/**
+ * @brief Indexes the content of `ctx` from the cursor to the end.
+ * @returns @link TOML_E_UNTERMINATED_STRING @endlink if a string isn't
+ *          closed, in which case the cursor is left at its opening quote.
+ *
+ * The cursor is left alone otherwise, the tape is what moves on.
+ */
+TOMLStatus TOMLTape_build(TOMLTape *tape, TOMLCtx *ctx)
+{
+  TOMLStatus status = TOML_E_OK;
+  char const *const content = ctx->offset;
+  size_t const len = ctx->end - content;
+  size_t resume = 0; // Flagged bytes before this one are skipped
+  size_t open = 0;
+  uint32_t escaped = 0;
+  int state = IN_NORMAL;
+  tape->base = content;
+  tape->len = 0;
+  if (len >= TAPE_MAX_CONTENT)
+  {
+    throw(OOM);
+  }
+  for (size_t block = 0; block < len; block += 64)
+  {
+    uint64_t mask;
+    if (len - block >= 64)
+    {
+      mask = TOML_scan_structural(content + block);
+    } else
+    {
+      char tail[64] = {0};
+      memcpy(tail, content + block, len - block);
+      mask = TOML_scan_structural(tail);
+    }
+    for (; mask != 0; mask &= mask - 1)
+    {
+      size_t const offset = block + __builtin_ctzll(mask);
+      char const c = content[offset];
+      if (offset < resume)
+      {
+        continue;
+      }
+      switch (state)
+      {
+        case IN_NORMAL:
+        {
+          if (c == '\\')
+          {
+            // Left for the second stage to reject along with the text
+            // around it.
+            break;
+          } else if (push(tape, offset) != 0)
+          {
+            throw(OOM);
+          }
+          if (c == '#')
+          {
+            state = IN_COMMENT;
+          } else if (c == '"' || c == '\'')
+          {
+            int const multiline = triple(content, len, offset, c);
+            open = offset;
+            escaped = 0;
+            resume = offset + (multiline ? 3 : 1);
+            state = c == '"' ? (multiline ? IN_ML_BASIC : IN_BASIC) :
+                               (multiline ? IN_ML_LITERAL : IN_LITERAL);
+          }
+        } break;
+        case IN_COMMENT:
+        {
+          if (c == '\n')
+          {
+            if (push(tape, offset) != 0)
+            {
+              throw(OOM);
+            }
+            state = IN_NORMAL;
+          }
+        } break;
+        case IN_BASIC:
+        case IN_LITERAL:
+        {
+          if (c == '\n')
+          {
+            ctx->offset = content + open;
+            throw(UNTERMINATED_STRING);
+          } else if (c == '\\' && state == IN_BASIC)
+          {
+            escaped = TOML_TAPE_ESCAPED;
+            resume = offset + 2;
+          } else if (c == (state == IN_BASIC ? '"' : '\''))
+          {
+            if (push(tape, offset | escaped) != 0)
+            {
+              throw(OOM);
+            }
+            state = IN_NORMAL;
+          }
+        } break;
+        case IN_ML_BASIC:
+        case IN_ML_LITERAL:
+        {
+          char const quote = state == IN_ML_BASIC ? '"' : '\'';
+          if (c == '\\' && state == IN_ML_BASIC)
+          {
+            escaped = TOML_TAPE_ESCAPED;
+            resume = offset + 2;
+          } else if (triple(content, len, offset, quote))
+          {
+            if (push(tape, offset | escaped) != 0)
+            {
+              throw(OOM);
+            }
+            resume = offset + 3;
+            state = IN_NORMAL;
+          }
+        } break;
+      }
+    }
+  }
+  if (state != IN_NORMAL && state != IN_COMMENT)
+  {
+    ctx->offset = content + open;
+    throw(UNTERMINATED_STRING);
+  }
+
+catch:
+  return status;
+}
+
+void TOMLTape_destroy(TOMLTape *tape)
+{
+  free(tape->items);
+  TOMLTape_init(tape);
+}
@@ -0,0 +1,40 @@
+/*
+ * @file tape.h
+ * @brief The structural index used by the two-stage parser.
+ */
+
+#ifndef C_TOML_TAPE_H
+#define C_TOML_TAPE_H
+#include <stdint.h>
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+
+#define TOML_TAPE_ESCAPED (UINT32_C(1) << 31) ///< Set on the closing quote of
+                                              ///< a string with escapes.
+#define TOML_TAPE_OFFSET(item) ((item) & ~TOML_TAPE_ESCAPED)
+
+typedef struct TOMLTape TOMLTape;
+
+/**
+ * @struct TOMLTape
+ * @brief The offsets of the structural characters of a document, in order.
+ *
+ * Those are `[ ] { } = , . #` and newlines outside of strings and comments,
+ * plus the opening and closing delimiter of every string, so the closing one
+ * always follows the opening one. Nothing inside a comment is recorded.
+ * Offsets are relative to `base` and the content can be at most 2 GiB.
+ */
+struct TOMLTape {
+  char const *base;  ///< What the offsets are relative to.
+  uint32_t   *items;
+  int         len;
+  int         cap;
+};
+
+#define TOMLTape_init(tape) (*(tape) = (TOMLTape) { NULL, NULL, 0, 0 })
+TOMLStatus TOMLTape_build  (TOMLTape *, TOMLCtx *);
+void       TOMLTape_destroy(TOMLTape *);
+TOMLStatus TOML_parse_tape (TOMLCtx *, TOMLTape const *, TOMLTable *);
+
+#endif /* C_TOML_TAPE_H */
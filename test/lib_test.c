@@ -1,3 +1,9 @@
+#define _DEFAULT_SOURCE
+#include <limits.h>
+#include <locale.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <c-ansi-sequences/graphics.h>
 #include <c-ansi-sequences/cursor.h>
 #include <c-ansi-sequences/screen.h>
@@ -95,6 +101,101 @@ void test_parse_number(void)
   CU_ASSERT_EQUAL_FATAL(value.float_, .1e3);
   CU_ASSERT_EQUAL_FATAL(position.offset, 5);
   CU_ASSERT_EQUAL_FATAL(position.column, 5);
+
+  ctx = make_toml("-6.25e-3", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.kind, TOML_FLOAT);
+  CU_ASSERT_EQUAL_FATAL(value.float_, -6.25e-3);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, 8);
+
+  ctx = make_toml("0.1", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.kind, TOML_FLOAT);
+  CU_ASSERT_EQUAL_FATAL(value.float_, 0.1);
+
+  // Needs all the digits to round correctly
+  ctx = make_toml("2.225_073_858_507_201_1e-308", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.float_, 2.2250738585072011e-308);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, 28);
+
+  // The decimal point of the locale doesn't matter, where there is a locale
+  // with a comma to try.
+  if (setlocale(LC_NUMERIC, "de_DE.UTF-8") != NULL)
+  {
+    ctx = make_toml("2.225_073_858_507_201_1e-308", 0);
+    CU_ASSERT_EQUAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+    setlocale(LC_NUMERIC, "C");
+    CU_ASSERT_EQUAL_FATAL(value.float_, 2.2250738585072011e-308);
+  }
+
+  ctx = make_toml("9007199254740993.0", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.float_, 9007199254740992.0);
+
+  ctx = make_toml("123456789012345678901234567890e-10", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.float_, 123456789012345678901234567890e-10);
+
+  ctx = make_toml("4.9e-324", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.float_, 4.9e-324);
+
+  ctx = make_toml("1.7976931348623159e308", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value),
+                        TOML_E_FLOAT_OVERFLOW);
+
+  ctx = make_toml("-1e400", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value),
+                        TOML_E_FLOAT_OVERFLOW);
+
+  ctx = make_toml("1e", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value),
+                        TOML_E_INVALID_NUMBER);
+
+  ctx = make_toml("0, 1", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.kind, TOML_INTEGER);
+  CU_ASSERT_EQUAL_FATAL(value.integer, 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, 1);
+
+  ctx = make_toml("1_234_567_890_123_456_789", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.integer, 1234567890123456789);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, 25);
+
+  ctx = make_toml("9223372036854775807", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.integer, LONG_MAX);
+
+  ctx = make_toml("-9223372036854775808", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.integer, LONG_MIN);
+
+  ctx = make_toml("9223372036854775808", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value),
+                        TOML_E_INT_OVERFLOW);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, 19);
+
+  ctx = make_toml("0x7fff_FFFF_ffff_FFFF", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.integer, LONG_MAX);
+
+  ctx = make_toml("0xDEADBEEFCAFEBABE", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value),
+                        TOML_E_INT_OVERFLOW);
+
+  ctx = make_toml("0o1_000_000_000_000_000_000_000", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value),
+                        TOML_E_INT_OVERFLOW);
+
+  ctx = make_toml("0b1010_0101", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(value.integer, 0xa5);
+
+  ctx = make_toml("0x", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_number(&ctx, &value),
+                        TOML_E_INVALID_NUMBER);
 }
 void test_parse_sl_string(void)
 {
@@ -125,6 +226,25 @@ void test_parse_sl_string(void)
   CU_ASSERT_EQUAL_FATAL(position.offset, 6);
   CU_ASSERT_EQUAL_FATAL(position.column, 6);
   String_cleanup(str);
+  str = NULL;
+
+  // Long enough for the vectorised scanner to find the escapes and the
+  // closing quote in the middle of a block.
+  ctx = make_toml("\"0123456789abcdefghijklmnopqrstuvwxyz\\t"
+                  "0123456789abcdefghijklmnopqrstuvwxyz\\\"quoted\\\"\" = 1",
+                  0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_sl_string(&ctx, &str), TOML_E_OK);
+  position = TOML_position(&ctx);
+  CU_ASSERT_STRING_EQUAL_FATAL(str,
+                               "0123456789abcdefghijklmnopqrstuvwxyz\t"
+                               "0123456789abcdefghijklmnopqrstuvwxyz"
+                               "\"quoted\"");
+  CU_ASSERT_EQUAL_FATAL(position.offset, 86);
+  String_cleanup(str);
+
+  ctx = make_toml("\"0123456789abcdefghijklmnopqrstuvwxyz\n\"", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_sl_string(&ctx, &str),
+                        TOML_E_UNTERMINATED_STRING);
 }
 
 void test_parse_ml_string(void)
@@ -156,6 +276,28 @@ void test_parse_ml_string(void)
   CU_ASSERT_EQUAL_FATAL(position.offset, 30);
   CU_ASSERT_EQUAL_FATAL(position.column, 9);
   String_cleanup(str);
+  str = NULL;
+
+  ctx = make_toml("\"\"\"-----BEGIN CERTIFICATE-----\n"
+                  "MIIBszCCAVmgAwIBAgIUQ2x1c3RlckNBIFJvb3QwCgYIKoZIzj0EAwIw\n"
+                  "single \" and double \"\" and escaped \\\"\"\" quotes\n"
+                  "-----END CERTIFICATE-----\"\"\"", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_ml_string(&ctx, &str), TOML_E_OK);
+  position = TOML_position(&ctx);
+  CU_ASSERT_STRING_EQUAL_FATAL(
+      str,
+      "-----BEGIN CERTIFICATE-----\n"
+      "MIIBszCCAVmgAwIBAgIUQ2x1c3RlckNBIFJvb3QwCgYIKoZIzj0EAwIw\n"
+      "single \" and double \"\" and escaped \"\"\" quotes\n"
+      "-----END CERTIFICATE-----"
+  );
+  CU_ASSERT_EQUAL_FATAL(position.line, 4);
+  CU_ASSERT_EQUAL_FATAL(position.column, 28);
+  String_cleanup(str);
+
+  ctx = make_toml("'''never closed''", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_ml_string(&ctx, &str),
+                        TOML_E_UNTERMINATED_STRING);
 }
 
 void test_parse_time(void)
@@ -1134,6 +1276,1445 @@ void test_parse(void)
   TOMLTable_destroy(table);
 }
 
+void test_arena(void)
+{
+  TOMLArena arena;
+  TOMLArena_init(&arena, 256);
+  TOMLCtx ctx = make_toml("title = \"arena\"\n"
+                  "[servers.alpha]\n"
+                  "ports = [8000, 8001, 8002, 8003, 8004, 8005]\n"
+                  "opts = { a = 1, b = 'two', c.d = [true] }\n"
+                  "[[clients]]\n"
+                  "name = \"\"\"first\"\"\"\n"
+                  "[[clients]]\n"
+                  "name = \"second\"", 0);
+  ctx.arena = &arena;
+  TOMLTable table = TOMLTable_new_in(&arena);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse(&ctx, &table), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), 3);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(table, "title")->string, "arena");
+
+  TOMLTable alpha = TBLGET(TBLGET(table, "servers")->table, "alpha")->table;
+  TOMLArray ports = TBLGET(alpha, "ports")->array;
+  CU_ASSERT_PTR_EQUAL_FATAL(TOMLArray_header(ports)->arena, &arena);
+  CU_ASSERT_EQUAL_FATAL(TOMLArray_len(ports), 6);
+  for (int i = 0; i < 6; ++i)
+  {
+    CU_ASSERT_EQUAL_FATAL(ports[i].integer, 8000 + i);
+  }
+  TOMLTable opts = TBLGET(alpha, "opts")->table;
+  CU_ASSERT_PTR_EQUAL_FATAL(TOMLTable_header(opts)->arena, &arena);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(opts, "b")->string, "two");
+  CU_ASSERT_TRUE_FATAL(
+      TBLGET(TBLGET(opts, "c")->table, "d")->array[0].boolean
+  );
+
+  TOMLArray clients = TBLGET(table, "clients")->array;
+  CU_ASSERT_EQUAL_FATAL(TOMLArray_len(clients), 2);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(clients[0].table, "name")->string,
+                               "first");
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(clients[1].table, "name")->string,
+                               "second");
+
+  // A no-op for arena tables, the arena frees everything at once.
+  TOMLTable_destroy(table);
+  TOMLArena_destroy(&arena);
+  CU_ASSERT_PTR_NULL_FATAL(arena.blocks);
+}
+
+void test_zero_copy(void)
+{
+  char const *data = "plain = \"value\"\n"
+                     "literal = 'C:\\path'\n"
+                     "escaped = \"tab\\there\"\n"
+                     "'quoted key'.inner = \"\"\"multi\nline\"\"\"\n"
+                     "\"esc\\\"key\" = 1\n";
+  TOMLCtx ctx = make_toml(data, 0);
+  ctx.flags = TOML_F_ZERO_COPY;
+  TOMLTable table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse(&ctx, &table), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), 5);
+
+  TOMLValue const *val_p = TBLGET(table, "plain");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_STRING_VIEW);
+  CU_ASSERT_EQUAL_FATAL(val_p->view.len, 5);
+  CU_ASSERT_FATAL(memcmp(val_p->view.data, "value", 5) == 0);
+  CU_ASSERT_FATAL(val_p->view.data > data &&
+                  val_p->view.data < data + strlen(data));
+
+  val_p = TBLGET(table, "literal");
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_STRING_VIEW);
+  CU_ASSERT_EQUAL_FATAL(TOMLValue_string(val_p).len, 7);
+  CU_ASSERT_FATAL(memcmp(TOMLValue_string(val_p).data, "C:\\path", 7) == 0);
+
+  val_p = TBLGET(table, "escaped");
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_STRING);
+  CU_ASSERT_STRING_EQUAL_FATAL(val_p->string, "tab\there");
+  CU_ASSERT_EQUAL_FATAL(TOMLValue_string(val_p).len, 8);
+
+  val_p = TBLGET(table, "quoted key");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_TABLE);
+  val_p = TBLGET(val_p->table, "inner");
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_STRING_VIEW);
+  CU_ASSERT_EQUAL_FATAL(val_p->view.len, 10);
+  CU_ASSERT_FATAL(memcmp(val_p->view.data, "multi\nline", 10) == 0);
+
+  val_p = TBLGET(table, "esc\"key");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+  CU_ASSERT_EQUAL_FATAL(val_p->integer, 1);
+
+  TOMLTable_destroy(table);
+}
+
+void test_parse_file(void)
+{
+  char const *path = "lib_test.toml";
+  // A whole page, ending in a comment with no newline, so that the parser
+  // has to rely on the padding behind the mapping to stop.
+  char data[4096];
+  int len = snprintf(data, sizeof(data), "title = 'mapped'\nport = 8080\n# ");
+  memset(data + len, 'x', sizeof(data) - len);
+  FILE *fp = fopen(path, "wb");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(fp);
+  CU_ASSERT_EQUAL_FATAL(fwrite(data, 1, sizeof(data), fp), sizeof(data));
+  fclose(fp);
+
+  TOMLCtx ctx;
+  TOMLTable table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(
+      TOML_parse_file(&ctx, path, NULL, TOML_F_ZERO_COPY, NULL, &table),
+      TOML_E_OK
+  );
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, sizeof(data));
+  CU_ASSERT_EQUAL_FATAL(ctx.end[0], '\0');
+  TOMLValue const *val_p = TBLGET(table, "title");
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_STRING_VIEW);
+  CU_ASSERT_FATAL(memcmp(val_p->view.data, "mapped", 6) == 0);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(table, "port")->integer, 8080);
+  TOMLTable_destroy(table);
+  TOML_unmap(&ctx);
+  CU_ASSERT_PTR_NULL_FATAL(ctx.content);
+
+  fp = fopen(path, "wb");
+  fclose(fp);
+  table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_file(&ctx, path, NULL, 0, NULL, &table),
+                        TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), 0);
+  TOMLTable_destroy(table);
+  TOML_unmap(&ctx);
+
+  fp = fopen(path, "wb");
+  fprintf(fp, "[a]\nport = 1\n[b]\nport = 2\n");
+  fclose(fp);
+  TOMLInterner keys;
+  TOMLInterner_init(&keys);
+  table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_file(&ctx, path, NULL, 0, &keys, &table),
+                        TOML_E_OK);
+  TOML_unmap(&ctx);
+  CU_ASSERT_PTR_EQUAL_FATAL(TBLGET(table, "a")->table[0].key,
+                            TBLGET(table, "b")->table[0].key);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(TBLGET(table, "b")->table, "port")->integer, 2);
+  TOMLTable_destroy(table);
+  TOMLInterner_destroy(&keys);
+  remove(path);
+
+  CU_ASSERT_EQUAL_FATAL(TOML_init_mmap(&ctx, path, NULL), TOML_E_IO);
+}
+
+typedef struct StreamSections {
+  TOMLTable tables[8];
+  int       count;
+} StreamSections;
+
+static TOMLStatus collect_section(void *data, TOMLTable table)
+{
+  StreamSections *sections = data;
+  if (sections->count == 8)
+  {
+    TOMLTable_destroy(table);
+    return TOML_E_OOM;
+  }
+  sections->tables[sections->count++] = table;
+  return TOML_E_OK;
+}
+
+void test_stream(void)
+{
+  char const *data = "title = \"inventory\"\n"
+                     "ports = [\n"
+                     "  [80, 443],\n"
+                     "  [8080]\n"
+                     "]\n"
+                     "# [not.a.section]\n"
+                     "[servers.alpha]\n"
+                     "ip = \"10.0.0.1\"\n"
+                     "motd = \"\"\"\n"
+                     "[looks.like.a.header]\n"
+                     "\"\"\\\"\"\"\"\n"
+                     "[\"odd]key\"]\n"
+                     "note = '''\n"
+                     "[[also.not]]'''\n"
+                     "[[hosts]]\n"
+                     "name = \"a\"\n"
+                     "[[hosts]]\n"
+                     "name = \"b\"";
+  size_t const len = strlen(data);
+  size_t const steps[] = { 1, 2, 3, 7, len };
+  for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); ++(i))
+  {
+    StreamSections sections = { .count = 0 };
+    TOMLStream stream;
+    TOMLStream_init(&stream, collect_section, &sections);
+    for (size_t offset = 0; offset < len; offset += steps[i])
+    {
+      size_t const step = len - offset < steps[i] ? len - offset : steps[i];
+      CU_ASSERT_EQUAL_FATAL(TOMLStream_feed(&stream, data + offset, step),
+                            TOML_E_OK);
+    }
+    CU_ASSERT_EQUAL_FATAL(TOMLStream_finish(&stream), TOML_E_OK);
+    TOMLStream_destroy(&stream);
+    CU_ASSERT_EQUAL_FATAL(sections.count, 5);
+
+    TOMLTable table = sections.tables[0];
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), 2);
+    CU_ASSERT_EQUAL_FATAL(TOMLArray_len(TBLGET(table, "ports")->array), 2);
+
+    table = TBLGET(TBLGET(sections.tables[1], "servers")->table,
+                   "alpha")->table;
+    CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(table, "ip")->string, "10.0.0.1");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(strstr(TBLGET(table, "motd")->string,
+                                        "[looks.like.a.header]\n\"\"\""));
+
+    table = TBLGET(sections.tables[2], "odd]key")->table;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(strstr(TBLGET(table, "note")->string,
+                                        "[[also.not]]"));
+
+    for (int j = 3; j < 5; ++(j))
+    {
+      TOMLValue const *hosts = TBLGET(sections.tables[j], "hosts");
+      CU_ASSERT_EQUAL_FATAL(hosts->kind, TOML_TABLE_ARRAY);
+      CU_ASSERT_EQUAL_FATAL(TOMLArray_len(hosts->array), 1);
+      CU_ASSERT_STRING_EQUAL_FATAL(
+          TBLGET(hosts->array[0].table, "name")->string, j == 3 ? "a" : "b"
+      );
+    }
+    for (int j = 0; j < sections.count; ++(j))
+    {
+      TOMLTable_destroy(sections.tables[j]);
+    }
+  }
+
+  StreamSections sections = { .count = 0 };
+  TOMLStream stream;
+  TOMLStream_init(&stream, collect_section, &sections);
+  data = "a = 1\n[b]\nc = \"unterminated\n";
+  CU_ASSERT_EQUAL_FATAL(TOMLStream_feed(&stream, data, strlen(data)),
+                        TOML_E_OK);
+  CU_ASSERT_NOT_EQUAL_FATAL(TOMLStream_finish(&stream), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(stream.position.line, 3);
+  TOMLStream_destroy(&stream);
+  CU_ASSERT_EQUAL_FATAL(sections.count, 1);
+  TOMLTable_destroy(sections.tables[0]);
+
+  sections.count = 0;
+  TOMLStream_init(&stream, collect_section, &sections);
+  stream.limit = 16;
+  data = "[a]\nkey = \"a value that is too long\"\n";
+  CU_ASSERT_EQUAL_FATAL(TOMLStream_feed(&stream, data, strlen(data)),
+                        TOML_E_SECTION_TOO_BIG);
+  TOMLStream_destroy(&stream);
+  CU_ASSERT_EQUAL_FATAL(sections.count, 0);
+}
+
+typedef struct EventLog {
+  char text[512];
+  int  len;
+} EventLog;
+
+#define LOG(data, ...)                                                  \
+  {                                                                     \
+    EventLog *log_p = (data);                                           \
+    log_p->len += snprintf(log_p->text + log_p->len,                    \
+                           sizeof(log_p->text) - log_p->len, __VA_ARGS__);\
+  }
+
+static TOMLStatus log_keys(EventLog *log, TOMLStringView const *keys,
+                           int count)
+{
+  for (int i = 0; i < count; ++(i))
+  {
+    LOG(log, "%s%.*s", i == 0 ? "" : ".", keys[i].len, keys[i].data);
+  }
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_header(void *data, TOMLStringView const *keys,
+                             int count, int is_tblarr)
+{
+  LOG(data, is_tblarr ? "[[" : "[");
+  log_keys(data, keys, count);
+  LOG(data, is_tblarr ? "]] " : "] ");
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_key(void *data, TOMLStringView const *keys, int count)
+{
+  log_keys(data, keys, count);
+  LOG(data, "=");
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_integer(void *data, signed long integer)
+{
+  LOG(data, "%ld ", integer);
+  return integer == 666 ? TOML_E_INVALID_VALUE : TOML_E_OK;
+}
+
+static TOMLStatus log_float(void *data, double float_)
+{
+  LOG(data, "%g ", float_);
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_boolean(void *data, bool boolean)
+{
+  LOG(data, boolean ? "true " : "false ");
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_string(void *data, TOMLStringView string)
+{
+  LOG(data, "'%.*s' ", string.len, string.data);
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_datetime(void *data, TOMLValue const *value)
+{
+  LOG(data, "%s ", value->kind == TOML_DATETIME ? "datetime" :
+                   value->kind == TOML_DATE     ? "date"     : "time");
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_array_begin(void *data)
+{
+  LOG(data, "( ");
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_array_end(void *data)
+{
+  LOG(data, ") ");
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_inline_table_begin(void *data)
+{
+  LOG(data, "{ ");
+  return TOML_E_OK;
+}
+
+static TOMLStatus log_inline_table_end(void *data)
+{
+  LOG(data, "} ");
+  return TOML_E_OK;
+}
+
+void test_events(void)
+{
+  EventLog log = { .len = 0 };
+  TOMLEvents const ev = {
+    .data = &(log),
+    .on_table_header = log_header,
+    .on_key = log_key,
+    .on_integer = log_integer,
+    .on_float = log_float,
+    .on_boolean = log_boolean,
+    .on_string = log_string,
+    .on_datetime = log_datetime,
+    .on_array_begin = log_array_begin,
+    .on_array_end = log_array_end,
+    .on_inline_table_begin = log_inline_table_begin,
+    .on_inline_table_end = log_inline_table_end
+  };
+  TOMLCtx ctx = make_toml("# a comment\n"
+                          "name = \"c-toml\"\n"
+                          "[server . \"http\"]\n"
+                          "port = 8080 # another one\n"
+                          "ratio = 0.5\n"
+                          "escaped = \"tab\\there\"\n"
+                          "limits = [1, [2, 3], { soft = true }]\n"
+                          "[[hosts]]\n"
+                          "started = 1979-05-27T07:32:00Z\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_events(&ctx, &ev), TOML_E_OK);
+  CU_ASSERT_STRING_EQUAL_FATAL(
+      log.text,
+      "name='c-toml' [server.http] port=8080 ratio=0.5 "
+      "escaped='tab\there' limits=( 1 ( 2 3 ) { soft=true } ) "
+      "[[hosts]] started=datetime "
+  );
+  CU_ASSERT_EQUAL_FATAL(ctx.flags, 0);
+
+  // Stopped by a callback
+  log.len = 0;
+  ctx = make_toml("a = [1, 666, 3]\nb = 2\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_events(&ctx, &ev), TOML_E_INVALID_VALUE);
+  CU_ASSERT_STRING_EQUAL_FATAL(log.text, "a=( 1 666 ");
+
+  TOMLEvents const none = { .data = NULL };
+  ctx = make_toml("a.b = { c = [1] }\n[d]\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_events(&ctx, &none), TOML_E_OK);
+
+  ctx = make_toml("a b = 1\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_events(&ctx, &none),
+                        TOML_E_ENTRY_INCOMPLETE);
+}
+
+void test_tape(void)
+{
+  char const *data = "# the header comment\n"
+                     "title = \"tape\" # and a trailing one\n"
+                     "pi = 3.14159\n"
+                     "'quoted.key' . inner = 'C:\\dir'\n"
+                     "escaped = \"a \\\"quoted\\\" word, [not] {structure}\"\n"
+                     "[servers.alpha]\n"
+                     "ports = [ 8000, # comment in an array\n"
+                     "          8001 ]\n"
+                     "opts = { a = 1, b.c = [true, 1979-05-27T07:32:00.5Z] }\n"
+                     "note = \"\"\"multi\n\"line\" = [\"\"\"\n"
+                     "[[clients]]\n"
+                     "name = 'first'\n"
+                     "[[clients]]\n"
+                     "name = 'second'\n";
+  TOMLCtx ctx = make_toml(data, 0);
+  TOMLTape tape;
+  TOMLTape_init(&tape);
+  CU_ASSERT_EQUAL_FATAL(TOMLTape_build(&tape, &ctx), TOML_E_OK);
+  CU_ASSERT_PTR_EQUAL_FATAL(ctx.offset, data);
+  // Only the newline of a comment is recorded
+  CU_ASSERT_EQUAL_FATAL(data[tape.items[0]], '#');
+  CU_ASSERT_EQUAL_FATAL(data[tape.items[1]], '\n');
+  CU_ASSERT_EQUAL_FATAL(data[tape.items[2]], '=');
+  CU_ASSERT_EQUAL_FATAL(tape.items[3], 29);
+  CU_ASSERT_EQUAL_FATAL(tape.items[4], 34);
+
+  TOMLTable table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_tape(&ctx, &tape, &table), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), 6);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(table, "title")->string, "tape");
+  CU_ASSERT_EQUAL_FATAL(TBLGET(table, "pi")->float_, 3.14159);
+  CU_ASSERT_STRING_EQUAL_FATAL(
+      TBLGET(TBLGET(table, "quoted.key")->table, "inner")->string, "C:\\dir"
+  );
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(table, "escaped")->string,
+                               "a \"quoted\" word, [not] {structure}");
+
+  TOMLTable alpha = TBLGET(TBLGET(table, "servers")->table, "alpha")->table;
+  TOMLArray ports = TBLGET(alpha, "ports")->array;
+  CU_ASSERT_EQUAL_FATAL(TOMLArray_len(ports), 2);
+  CU_ASSERT_EQUAL_FATAL(ports[0].integer, 8000);
+  CU_ASSERT_EQUAL_FATAL(ports[1].integer, 8001);
+  TOMLTable opts = TBLGET(alpha, "opts")->table;
+  CU_ASSERT_EQUAL_FATAL(TBLGET(opts, "a")->integer, 1);
+  TOMLArray c = TBLGET(TBLGET(opts, "b")->table, "c")->array;
+  CU_ASSERT_EQUAL_FATAL(TOMLArray_len(c), 2);
+  CU_ASSERT_TRUE_FATAL(c[0].boolean);
+  CU_ASSERT_EQUAL_FATAL(c[1].kind, TOML_DATETIME);
+  CU_ASSERT_EQUAL_FATAL(c[1].datetime.time.millisec, 5);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(alpha, "note")->string,
+                               "multi\n\"line\" = [");
+
+  TOMLArray clients = TBLGET(table, "clients")->array;
+  CU_ASSERT_EQUAL_FATAL(TOMLArray_len(clients), 2);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(clients[1].table, "name")->string,
+                               "second");
+  TOMLTable_destroy(table);
+
+  // Escapes and strings across the 64 byte blocks of the first stage
+  char long_data[256];
+  int len = snprintf(long_data, sizeof(long_data), "k = \"%060d\\\"\"\n"
+                     "v = '%070d'\n", 0, 0);
+  ctx = make_toml(long_data, 0);
+  ctx.flags = TOML_F_ZERO_COPY;
+  CU_ASSERT_EQUAL_FATAL(TOMLTape_build(&tape, &ctx), TOML_E_OK);
+  table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_tape(&ctx, &tape, &table), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, len);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(table, "k")->kind, TOML_STRING);
+  CU_ASSERT_EQUAL_FATAL(String_len(TBLGET(table, "k")->string), 61);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(table, "v")->kind, TOML_STRING_VIEW);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(table, "v")->view.len, 70);
+  TOMLTable_destroy(table);
+
+  ctx = make_toml("a = 1\nb = \"open\nc = 2\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLTape_build(&tape, &ctx),
+                        TOML_E_UNTERMINATED_STRING);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).offset, 10);
+
+  char const *errors[] = {
+    "a = 1 b = 2\n", "a = [1 2]\n", "a = 1\na = 2\n", "[a]]\nb = 1\n",
+    "a = {b = 1,}\n", "a b = 1\n", "a = tru\n"
+  };
+  TOMLStatus const statuses[] = {
+    TOML_E_UNEXPECTED_CHAR, TOML_E_COMMA_OR_BRACKET, TOML_E_DUPLICATE_KEY,
+    TOML_E_TABLE_HEADER, TOML_E_ENTRY_EXPECTED, TOML_E_ENTRY_INCOMPLETE,
+    TOML_E_INVALID_VALUE
+  };
+  for (int i = 0; i < (int)(sizeof(errors) / sizeof(errors[0])); ++i)
+  {
+    ctx = make_toml(errors[i], 0);
+    table = TOMLTable_new();
+    CU_ASSERT_EQUAL_FATAL(TOMLTape_build(&tape, &ctx), TOML_E_OK);
+    CU_ASSERT_EQUAL_FATAL(TOML_parse_tape(&ctx, &tape, &table), statuses[i]);
+    TOMLTable_destroy(table);
+  }
+  TOMLTape_destroy(&tape);
+  CU_ASSERT_PTR_NULL_FATAL(tape.items);
+}
+
+void test_doc(void)
+{
+  char const *data = "title = \"lazy\"\n"
+                     "ports = [8000, [\"a]\", 'b'], { c = '}' }]\n"
+                     "bad = tru\n"
+                     "[servers.alpha]\n"
+                     "ip = \"10.0.0.1\" # comment\n"
+                     "pi = 3.14\n"
+                     "[[clients]]\n"
+                     "name = 'first'\n";
+  TOMLCtx ctx = make_toml(data, 0);
+  TOMLDoc doc;
+  TOMLValue const *val_p;
+  CU_ASSERT_EQUAL_FATAL(TOMLDoc_open(&doc, &ctx), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(doc.root), 5);
+  // Nothing is decoded yet
+  CU_ASSERT_EQUAL_FATAL(TBLGET(doc.root, "title")->kind, TOML_LAZY);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(doc.root, "ports")->kind, TOML_LAZY);
+
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, doc.root, String_fake("title"), &val_p), TOML_E_OK
+  );
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_STRING);
+  CU_ASSERT_STRING_EQUAL_FATAL(val_p->string, "lazy");
+  CU_ASSERT_PTR_EQUAL_FATAL(val_p, TBLGET(doc.root, "title"));
+
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, doc.root, String_fake("ports"), &val_p), TOML_E_OK
+  );
+  CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_ARRAY);
+  CU_ASSERT_EQUAL_FATAL(TOMLArray_len(val_p->array), 3);
+  CU_ASSERT_EQUAL_FATAL(val_p->array[0].integer, 8000);
+  CU_ASSERT_STRING_EQUAL_FATAL(val_p->array[1].array[0].string, "a]");
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(val_p->array[2].table, "c")->string,
+                               "}");
+
+  // Errors show up when the value is looked up
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, doc.root, String_fake("bad"), &val_p),
+      TOML_E_INVALID_VALUE
+  );
+  CU_ASSERT_PTR_NULL_FATAL(val_p);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&(doc.ctx)).line, 3);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(doc.root, "bad")->kind, TOML_LAZY);
+
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, doc.root, String_fake("servers"), &val_p), TOML_E_OK
+  );
+  TOMLTable alpha = TBLGET(val_p->table, "alpha")->table;
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, alpha, String_fake("ip"), &val_p), TOML_E_OK
+  );
+  CU_ASSERT_STRING_EQUAL_FATAL(val_p->string, "10.0.0.1");
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, alpha, String_fake("pi"), &val_p), TOML_E_OK
+  );
+  CU_ASSERT_EQUAL_FATAL(val_p->float_, 3.14);
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, alpha, String_fake("none"), &val_p), TOML_E_OK
+  );
+  CU_ASSERT_PTR_NULL_FATAL(val_p);
+
+  TOMLArray clients = TBLGET(doc.root, "clients")->array;
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLDoc_get(&doc, clients[0].table, String_fake("name"), &val_p),
+      TOML_E_OK
+  );
+  CU_ASSERT_STRING_EQUAL_FATAL(val_p->string, "first");
+  TOMLDoc_destroy(&doc);
+
+  // Structural errors are still found up front
+  ctx = make_toml("a = 1\na = [2\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLDoc_open(&doc, &ctx), TOML_E_DUPLICATE_KEY);
+  TOMLDoc_destroy(&doc);
+  ctx = make_toml("a = [1, 2\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLDoc_open(&doc, &ctx), TOML_E_ARRAY);
+  TOMLDoc_destroy(&doc);
+  ctx = make_toml("a = 1 b = 2\n", 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLDoc_open(&doc, &ctx), TOML_E_UNEXPECTED_CHAR);
+  TOMLDoc_destroy(&doc);
+}
+
+void test_table(void)
+{
+  enum { KEYS = 2000 };
+  static char names[KEYS][8];
+  TOMLStringView keys[KEYS];
+  TOMLTable table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(sizeof(TOMLValue), 16);
+  CU_ASSERT_EQUAL_FATAL(sizeof(TOMLTable_Bucket), 16);
+  CU_ASSERT_EQUAL_FATAL((uintptr_t)TOMLTable_value(table, 0) % 16, 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_size(table), 0);
+  CU_ASSERT_PTR_NULL_FATAL(TBLGET(table, "key0"));
+  for (int i = 0; i < KEYS; ++i)
+  {
+    // Small tables are scanned, they only get an index once they're full.
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_size(table) == 0,
+                          i <= TOML_TABLE_SMALL);
+    keys[i] = (TOMLStringView) { names[i], sprintf(names[i], "key%d", i) };
+    TOMLValue *val_p = TOMLTable_put_view(&table, keys[i]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, 0);
+    val_p->kind = TOML_INTEGER;
+    val_p->integer = i;
+    for (int j = 0; j < TOML_TABLE_SMALL && j <= i; ++j)
+    {
+      CU_ASSERT_EQUAL_FATAL(TOMLTable_get_view(table, keys[j])->integer, j);
+    }
+  }
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), KEYS);
+#ifdef TOML_TABLE_ROBIN_HOOD
+  CU_ASSERT_TRUE_FATAL(TOMLTable_max_probe(table) >= 1 &&
+                       TOMLTable_max_probe(table) <= 128);
+#else
+  CU_ASSERT_TRUE_FATAL(TOMLTable_max_probe(table) >= 1 &&
+                       TOMLTable_max_probe(table) <=
+                         TOMLTable_size(table) / TOML_TABLE_GROUP);
+#endif
+  CU_ASSERT_PTR_EQUAL_FATAL(TOMLTable_put_view(&table, keys[7]),
+                            TOMLTable_get_view(table, keys[7]));
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), KEYS);
+  for (int i = 0; i < KEYS; ++i)
+  {
+    TOMLValue const *val_p = TOMLTable_get_view(table, keys[i]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+    CU_ASSERT_EQUAL_FATAL(val_p->integer, i);
+  }
+
+  // Every other key goes away, the rest stay reachable past the holes.
+  TOMLValue popped;
+  for (int i = 0; i < KEYS; i += 2)
+  {
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_pop_view(table, keys[i], &popped), 0);
+    CU_ASSERT_EQUAL_FATAL(popped.integer, i);
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_pop_view(table, keys[i], NULL), -1);
+  }
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), KEYS / 2);
+  CU_ASSERT_FALSE_FATAL(TOMLTable_has_key(table, String_fake("key0")));
+  CU_ASSERT_TRUE_FATAL(TOMLTable_has_key(table, String_fake("key1")));
+  for (int i = 0; i < KEYS; ++i)
+  {
+    TOMLValue const *val_p = TOMLTable_get_view(table, keys[i]);
+    CU_ASSERT_EQUAL_FATAL(val_p == NULL, i % 2 == 0);
+  }
+
+  // Putting them back doesn't grow the index, and they go after the rest.
+  int const size = TOMLTable_size(table);
+  for (int i = 0; i < KEYS; i += 2)
+  {
+    TOMLValue *val_p = TOMLTable_put_view(&table, keys[i]);
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, 0);
+    *val_p = (TOMLValue) { .integer = -i, .kind = TOML_INTEGER };
+  }
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_size(table), size);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), KEYS);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_get_view(table, keys[10])->integer, -10);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_get_view(table, keys[11])->integer, 11);
+  // The kept odd keys come first, then the even ones in the order they were
+  // put back.
+  int next = 1;
+  for (int i = 0; i < TOMLTable_len(table); ++i)
+  {
+    if (table[i].key != NULL)
+    {
+      TOMLValue const *val_p = TOMLTable_value(table, i);
+      CU_ASSERT_EQUAL_FATAL(next % 2 ? val_p->integer : -val_p->integer,
+                            next);
+      next = next + 2 == KEYS + 1 ? 0 : next + 2;
+    }
+  }
+  CU_ASSERT_EQUAL_FATAL(next, KEYS);
+  TOMLTable_destroy(table);
+
+  // Keys with the same length and first bytes, and removed ones, in a small
+  // table.
+  table = TOMLTable_new();
+  char const *similar[] = { "", "abc1", "abc2", "abc", "abcd" };
+  for (int i = 0; i < 5; ++i)
+  {
+    TOMLStringView const key = { similar[i], strlen(similar[i]) };
+    *TOMLTable_put_view(&table, key) =
+      (TOMLValue) { .integer = i, .kind = TOML_INTEGER };
+  }
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_pop(table, String_fake("abc1"), NULL), 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_pop(table, String_fake(""), NULL), 0);
+  CU_ASSERT_PTR_NULL_FATAL(TBLGET(table, "abc1"));
+  CU_ASSERT_PTR_NULL_FATAL(TBLGET(table, ""));
+  CU_ASSERT_PTR_NULL_FATAL(TBLGET(table, "ab"));
+  CU_ASSERT_EQUAL_FATAL(TBLGET(table, "abc2")->integer, 2);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(table, "abcd")->integer, 4);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_size(table), 0);
+  TOMLTable_destroy(table);
+}
+
+void test_freeze(void)
+{
+  enum { KEYS = 500 };
+  static char names[KEYS][8];
+  TOMLStringView keys[KEYS];
+  TOMLTable table = TOMLTable_new();
+  for (int i = 0; i < KEYS; ++i)
+  {
+    keys[i] = (TOMLStringView) { names[i], sprintf(names[i], "key%d", i) };
+    TOMLValue *val_p = TOMLTable_put_view(&table, keys[i]);
+    *val_p = (TOMLValue) { .integer = i, .kind = TOML_INTEGER };
+  }
+  for (int i = 0; i < KEYS; i += 3)
+  {
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_pop_view(table, keys[i], NULL), 0);
+  }
+  int const count = TOMLTable_count(table);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_freeze(&table), 0);
+  CU_ASSERT_TRUE_FATAL(TOMLTable_frozen(table));
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), count);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_len(table), count);
+  for (int i = 0; i < KEYS; ++i)
+  {
+    TOMLValue const *val_p = TOMLTable_get_view(table, keys[i]);
+    CU_ASSERT_EQUAL_FATAL(val_p == NULL, i % 3 == 0);
+    CU_ASSERT_TRUE_FATAL(val_p == NULL || val_p->integer == i);
+  }
+  // The keys were copied and kept their order.
+  CU_ASSERT_PTR_NOT_EQUAL_FATAL(table[0].key, names[1]);
+  CU_ASSERT_NSTRING_EQUAL_FATAL(table[0].key, "key1", 4);
+  CU_ASSERT_NSTRING_EQUAL_FATAL(table[count - 1].key, "key499", 6);
+  CU_ASSERT_PTR_NULL_FATAL(TOMLTable_put_view(&table, keys[0]));
+  CU_ASSERT_PTR_EQUAL_FATAL(TOMLTable_put_view(&table, keys[1]),
+                            TOMLTable_get_view(table, keys[1]));
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_pop_view(table, keys[1], NULL), -1);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_freeze(&table), 0);
+  TOMLTable_destroy(table);
+
+  // Nested tables, inline ones and the ones in arrays are frozen too.
+  TOMLCtx ctx = make_toml("title = \"frozen\"\n"
+                          "[servers.alpha]\n"
+                          "opts = { a = 1, b = [{ c = 2 }] }\n"
+                          "[[clients]]\n"
+                          "name = \"first\"\n", 0);
+  table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse(&ctx, &table), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_freeze(&table), 0);
+  TOMLTable alpha = TBLGET(TBLGET(table, "servers")->table, "alpha")->table;
+  TOMLTable opts = TBLGET(alpha, "opts")->table;
+  TOMLTable inner = TBLGET(opts, "b")->array[0].table;
+  TOMLTable client = TBLGET(table, "clients")->array[0].table;
+  CU_ASSERT_TRUE_FATAL(TOMLTable_frozen(alpha) && TOMLTable_frozen(opts) &&
+                       TOMLTable_frozen(inner) && TOMLTable_frozen(client));
+  CU_ASSERT_EQUAL_FATAL(TBLGET(inner, "c")->integer, 2);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(client, "name")->string, "first");
+  CU_ASSERT_PTR_NULL_FATAL(TBLGET(opts, "d"));
+  TOMLTable_destroy(table);
+
+  // Enough keys for some of their 32-bit hashes to collide.
+  enum { MANY = 200000 };
+  static char many[MANY][12];
+  table = TOMLTable_with_size(MANY);
+  for (int i = 0; i < MANY; ++i)
+  {
+    TOMLStringView const key = { many[i], sprintf(many[i], "k%d", i) };
+    TOMLValue *val_p = TOMLTable_put_view(&table, key);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+    *val_p = (TOMLValue) { .integer = i, .kind = TOML_INTEGER };
+  }
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_freeze(&table), 0);
+  for (int i = 0; i < MANY; ++i)
+  {
+    TOMLStringView const key = { many[i], strlen(many[i]) };
+    TOMLValue const *val_p = TOMLTable_get_view(table, key);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+    CU_ASSERT_EQUAL_FATAL(val_p->integer, i);
+  }
+  TOMLTable_destroy(table);
+}
+
+void test_intern(void)
+{
+  TOMLInterner keys;
+  TOMLInterner_init(&keys);
+  TOMLKey const *port = TOMLInterner_intern(&keys, "port", 4);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(port);
+  CU_ASSERT_PTR_EQUAL_FATAL(TOMLInterner_intern(&keys, "port", 4), port);
+  CU_ASSERT_STRING_EQUAL_FATAL(port->data, "port");
+  CU_ASSERT_EQUAL_FATAL(keys.count, 1);
+
+  TOMLCtx ctx = make_toml("[[servers]]\n"
+                          "host = \"alpha\"\n"
+                          "port = 8000\n"
+                          "[[servers]]\n"
+                          "\"host\" = \"beta\"\n"
+                          "port = 8001\n"
+                          "tags = { \"h\\x6fst\" = 1 }\n", 0);
+  ctx.keys = &keys;
+  TOMLTable table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse(&ctx, &table), TOML_E_OK);
+  TOMLArray servers = TBLGET(table, "servers")->array;
+  TOMLTable alpha = servers[0].table;
+  TOMLTable beta = servers[1].table;
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(alpha, "host")->string, "alpha");
+  CU_ASSERT_EQUAL_FATAL(TBLGET(beta, "port")->integer, 8001);
+  // Every "host" and "port" is the same copy, even the quoted and escaped
+  // ones.
+  CU_ASSERT_PTR_EQUAL_FATAL(alpha[0].key, beta[0].key);
+  CU_ASSERT_PTR_EQUAL_FATAL(alpha[1].key, port->data);
+  CU_ASSERT_PTR_EQUAL_FATAL(beta[1].key, port->data);
+  CU_ASSERT_PTR_EQUAL_FATAL(TBLGET(beta, "tags")->table[0].key, alpha[0].key);
+  CU_ASSERT_EQUAL_FATAL(keys.count, 4);
+  CU_ASSERT_PTR_EQUAL_FATAL(TOMLTable_put_key(&alpha, port),
+                            TBLGET(alpha, "port"));
+  TOMLTable_destroy(table);
+  TOMLInterner_destroy(&keys);
+}
+
+void test_get_key(void)
+{
+  enum { KEYS = 100 };
+  static char names[KEYS][8];
+  TOMLKey keys[KEYS];
+  TOMLTable table = TOMLTable_new();
+  for (int i = 0; i < KEYS; ++i)
+  {
+    keys[i] = TOMLKey_make(names[i], sprintf(names[i], "key%d", i));
+    TOMLStringView const view = { keys[i].data, keys[i].len };
+    TOMLValue *val_p = TOMLTable_put_view(&table, view);
+    *val_p = (TOMLValue) { .integer = i, .kind = TOML_INTEGER };
+    CU_ASSERT_PTR_EQUAL_FATAL(TOMLTable_get_key(table, &(keys[i])), val_p);
+    TOMLStringView const first = { keys[0].data, keys[0].len };
+    CU_ASSERT_PTR_EQUAL_FATAL(TOMLTable_get_key(table, &(keys[0])),
+                              TOMLTable_get_view(table, first));
+  }
+  TOMLKey const missing = TOMLKey_make("key100", 6);
+  CU_ASSERT_PTR_NULL_FATAL(TOMLTable_get_key(table, &(missing)));
+  // Frozen tables hash with a seed of their own.
+  CU_ASSERT_EQUAL_FATAL(TOMLTable_freeze(&table), 0);
+  for (int i = 0; i < KEYS; ++i)
+  {
+    TOMLValue const *val_p = TOMLTable_get_key(table, &(keys[i]));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+    CU_ASSERT_EQUAL_FATAL(val_p->integer, i);
+  }
+  CU_ASSERT_PTR_NULL_FATAL(TOMLTable_get_key(table, &(missing)));
+  TOMLTable_destroy(table);
+}
+
+void test_pack_arrays(void)
+{
+  char const *data = "ints = [1, 2, -3]\n"
+                     "floats = [0.5, 1.5, -2.0]\n"
+                     "flags = [true, false, true, true, false, true, true,\n"
+                     "         false, true, true, false, true, true, false,\n"
+                     "         true, true, false, true, true, false, true,\n"
+                     "         true, false, true, true, false, true, true,\n"
+                     "         false, true, true, false, true, true, false,\n"
+                     "         true, true, false, true, true, false, true,\n"
+                     "         true, false, true, true, false, true, true,\n"
+                     "         false, true, true, false, true, true, false,\n"
+                     "         true, true, false, true, true, false, true,\n"
+                     "         true, false, true, true, false, true, true]\n"
+                     "names = ['alpha', \"b\\x65ta\", \"\"]\n"
+                     "mixed = [1, 2, 'three']\n"
+                     "nested = [[1, 2], [3.0]]\n"
+                     "empty = []\n";
+  for (int two_stage = 0; two_stage < 2; ++two_stage)
+  {
+    TOMLCtx ctx = make_toml(data, 0);
+    ctx.flags |= TOML_F_PACK_ARRAYS;
+    TOMLTable table = TOMLTable_new();
+    if (two_stage)
+    {
+      TOMLTape tape;
+      TOMLTape_init(&tape);
+      CU_ASSERT_EQUAL_FATAL(TOMLTape_build(&tape, &ctx), TOML_E_OK);
+      CU_ASSERT_EQUAL_FATAL(TOML_parse_tape(&ctx, &tape, &table), TOML_E_OK);
+      TOMLTape_destroy(&tape);
+    } else
+    {
+      CU_ASSERT_EQUAL_FATAL(TOML_parse(&ctx, &table), TOML_E_OK);
+    }
+
+    TOMLValue const *val_p = TBLGET(table, "ints");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_PACKED_ARRAY);
+    CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_len(val_p->packed), 3);
+    int64_t const *ints = TOMLPackedArray_integers(val_p->packed);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ints);
+    CU_ASSERT_EQUAL_FATAL(ints[2], -3);
+    CU_ASSERT_PTR_NULL_FATAL(TOMLPackedArray_floats(val_p->packed));
+
+    val_p = TBLGET(table, "floats");
+    CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_kind(val_p->packed), TOML_FLOAT);
+    CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_floats(val_p->packed)[1], 1.5);
+
+    val_p = TBLGET(table, "flags");
+    CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_len(val_p->packed), 70);
+    for (int i = 0; i < 70; ++i)
+    {
+      CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_boolean(val_p->packed, i),
+                            i % 3 != 1);
+    }
+
+    val_p = TBLGET(table, "names");
+    TOMLStringView name = TOMLPackedArray_string(val_p->packed, 1);
+    CU_ASSERT_EQUAL_FATAL(name.len, 4);
+    CU_ASSERT_STRING_EQUAL_FATAL(name.data, "beta");
+    CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_string(val_p->packed, 2).len, 0);
+    TOMLValue item;
+    TOMLPackedArray_get(val_p->packed, 0, &(item));
+    CU_ASSERT_EQUAL_FATAL(item.kind, TOML_STRING_VIEW);
+    CU_ASSERT_NSTRING_EQUAL_FATAL(item.view.data, "alpha", 5);
+
+    // Arrays that turn out not to be homogeneous are regular ones.
+    val_p = TBLGET(table, "mixed");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_ARRAY);
+    CU_ASSERT_EQUAL_FATAL(TOMLArray_len(val_p->array), 3);
+    CU_ASSERT_EQUAL_FATAL(val_p->array[1].integer, 2);
+    CU_ASSERT_STRING_EQUAL_FATAL(val_p->array[2].string, "three");
+    val_p = TBLGET(table, "nested");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_ARRAY);
+    CU_ASSERT_EQUAL_FATAL(val_p->array[1].kind, TOML_PACKED_ARRAY);
+    CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_kind(val_p->array[1].packed),
+                          TOML_FLOAT);
+    val_p = TBLGET(table, "empty");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_ARRAY);
+    CU_ASSERT_EQUAL_FATAL(TOMLArray_len(val_p->array), 0);
+
+    // The buffer can be taken without copying it.
+    TOMLPackedArray floats = TBLGET(table, "floats")->packed;
+    double const *buffer = TOMLPackedArray_floats(floats);
+    double *taken = TOMLPackedArray_release(floats, NULL);
+    CU_ASSERT_PTR_EQUAL_FATAL(taken, buffer);
+    CU_ASSERT_EQUAL_FATAL(taken[2], -2.0);
+    CU_ASSERT_EQUAL_FATAL(TOMLPackedArray_len(floats), 0);
+    free(taken);
+    TOMLTable_destroy(table);
+  }
+}
+
+void test_short_strings(void)
+{
+  char const *data = "empty = ''\n"
+                     "short = \"alpha\"\n"
+                     "longest = 'abcdefghijk'\n"
+                     "long = 'abcdefghijkl'\n"
+                     "escaped = \"tab\\there\"\n"
+                     "list = ['a', 'bc', \"long enough to allocate\"]\n";
+  for (int two_stage = 0; two_stage < 2; ++two_stage)
+  {
+    TOMLCtx ctx = make_toml(data, 0);
+    ctx.flags |= TOML_F_SHORT_STRINGS;
+    TOMLTable table = TOMLTable_new();
+    if (two_stage)
+    {
+      TOMLTape tape;
+      TOMLTape_init(&tape);
+      CU_ASSERT_EQUAL_FATAL(TOMLTape_build(&tape, &ctx), TOML_E_OK);
+      CU_ASSERT_EQUAL_FATAL(TOML_parse_tape(&ctx, &tape, &table), TOML_E_OK);
+      TOMLTape_destroy(&tape);
+    } else
+    {
+      CU_ASSERT_EQUAL_FATAL(TOML_parse(&ctx, &table), TOML_E_OK);
+    }
+    TOMLValue const *val_p = TBLGET(table, "empty");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_SHORT_STRING);
+    CU_ASSERT_EQUAL_FATAL(TOMLValue_string(val_p).len, 0);
+    val_p = TBLGET(table, "short");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_SHORT_STRING);
+    CU_ASSERT_STRING_EQUAL_FATAL(val_p->short_string, "alpha");
+    CU_ASSERT_EQUAL_FATAL(TOMLValue_string(val_p).len, 5);
+    val_p = TBLGET(table, "longest");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_SHORT_STRING);
+    CU_ASSERT_STRING_EQUAL_FATAL(TOMLValue_string(val_p).data, "abcdefghijk");
+    CU_ASSERT_EQUAL_FATAL(TOMLValue_string(val_p).len, TOML_SHORT_STRING_MAX);
+    val_p = TBLGET(table, "long");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_STRING);
+    CU_ASSERT_STRING_EQUAL_FATAL(val_p->string, "abcdefghijkl");
+    val_p = TBLGET(table, "escaped");
+    CU_ASSERT_EQUAL_FATAL(val_p->kind, TOML_SHORT_STRING);
+    CU_ASSERT_STRING_EQUAL_FATAL(val_p->short_string, "tab\there");
+    TOMLArray list = TBLGET(table, "list")->array;
+    CU_ASSERT_EQUAL_FATAL(list[1].kind, TOML_SHORT_STRING);
+    CU_ASSERT_STRING_EQUAL_FATAL(list[1].short_string, "bc");
+    CU_ASSERT_EQUAL_FATAL(list[2].kind, TOML_STRING);
+    TOMLTable_destroy(table);
+  }
+}
+
+/*
+ * Puts the keys `extra0` to `extra15` into `*table_p`, with their numbers as
+ * values. The table borrows the keys, so they are static to outlive it.
+ */
+static void put_extras(TOMLTable *table_p)
+{
+  static char keys[16][8];
+  for (int i = 0; i < 16; ++i)
+  {
+    TOMLStringView const view = { keys[i], sprintf(keys[i], "extra%d", i) };
+    TOMLValue *extra_p = TOMLTable_put_view(table_p, view);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(extra_p);
+    *extra_p = (TOMLValue) { .integer = i, .kind = TOML_INTEGER };
+  }
+}
+
+void test_parse_parallel(void)
+{
+  // Big enough to be cut into a few chunks, with a table reopened and a
+  // table array added to all over the document.
+  size_t const cap = 1 << 20;
+  char *data = malloc(cap);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(data);
+  int len = sprintf(data, "title = 'parallel'\n");
+  int const sections = 8000;
+  for (int i = 0; i < sections; ++i)
+  {
+    len += sprintf(data + len, "[section.s%d]\n"
+                               "name = \"section number %d\"\n"
+                               "list = [%d, %d, %d]\n"
+                               "[shared]\n"
+                               "k%d = %d\n"
+                               "[[items]]\n"
+                               "id = %d\n", i, i, i, i + 1, i + 2, i, i, i);
+  }
+  CU_ASSERT_FATAL((size_t)len < cap);
+  for (int mode = 0; mode < 3; ++mode)
+  {
+    TOMLArena arena;
+    TOMLArena_init(&arena, 0);
+    TOMLCtx ctx = make_toml(data, 0);
+    ctx.flags = mode == 2 ? TOML_F_ZERO_COPY : 0;
+    ctx.arena = mode == 1 ? &arena : NULL;
+    TOMLTable table = TOMLTable_new_in(ctx.arena);
+    CU_ASSERT_EQUAL_FATAL(TOML_parse_parallel(&ctx, &table, 4), TOML_E_OK);
+    CU_ASSERT_PTR_EQUAL_FATAL(ctx.offset, data + len);
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_count(table), 4);
+    TOMLTable section = TBLGET(table, "section")->table;
+    TOMLTable shared = TBLGET(table, "shared")->table;
+    TOMLArray items = TBLGET(table, "items")->array;
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_count(section), sections);
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_count(shared), sections);
+    CU_ASSERT_EQUAL_FATAL(TOMLArray_len(items), sections);
+    for (int i = 0; i < sections; ++i)
+    {
+      char key[16];
+      sprintf(key, "s%d", i);
+      // The keys are still in document order.
+      CU_ASSERT_EQUAL_FATAL(section[i].key_len, (int)strlen(key));
+      CU_ASSERT_FATAL(memcmp(section[i].key, key, strlen(key)) == 0);
+      TOMLTable s = TOMLTable_value(section, i)->table;
+      CU_ASSERT_EQUAL_FATAL(TBLGET(s, "list")->array[2].integer, i + 2);
+      TOMLStringView const view = { key, sprintf(key, "k%d", i) };
+      CU_ASSERT_EQUAL_FATAL(TOMLTable_get_view(shared, view)->integer, i);
+      CU_ASSERT_EQUAL_FATAL(TBLGET(items[i].table, "id")->integer, i);
+    }
+    // The tables the threads built can still grow and be frozen, in the
+    // arena of the document.
+    put_extras(&(((TOMLValue *)TBLGET(section, "s5000"))->table));
+    CU_ASSERT_EQUAL_FATAL(TOMLTable_freeze(&table), 0);
+    section = TBLGET(table, "section")->table;
+    CU_ASSERT_EQUAL_FATAL(
+        TBLGET(TBLGET(section, "s5000")->table, "extra15")->integer, 15
+    );
+    TOMLTable_destroy(table);
+    TOMLArena_destroy(&arena);
+  }
+
+  // A key defined again in a later chunk.
+  len += sprintf(data + len, "[shared]\nk0 = 0\n");
+  TOMLCtx ctx = make_toml(data, 0);
+  TOMLTable table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_parallel(&ctx, &table, 4),
+                        TOML_E_DUPLICATE_KEY);
+  TOMLTable_destroy(table);
+  // A table defined where a table array was.
+  len = len - strlen("[shared]\nk0 = 0\n");
+  sprintf(data + len, "[items]\n");
+  ctx = make_toml(data, 0);
+  table = TOMLTable_new();
+  CU_ASSERT_EQUAL_FATAL(TOML_parse_parallel(&ctx, &table, 4),
+                        TOML_E_EXPECTED_TABLE);
+  TOMLTable_destroy(table);
+  free(data);
+}
+
+void test_parse_many(void)
+{
+  enum { FILES = 24 };
+  char paths[FILES][32];
+  char const *path_ps[FILES];
+  for (int i = 0; i < FILES; ++i)
+  {
+    sprintf(paths[i], "lib_test_%d.toml", i);
+    path_ps[i] = paths[i];
+    FILE *fp = fopen(paths[i], "wb");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fp);
+    if (i == 7)
+    {
+      fprintf(fp, "name = 'broken'\nport = = 1\n");
+    } else
+    {
+      fprintf(fp, "name = 'service %d'\n[limits]\nport = %d\n", i, 8000 + i);
+    }
+    fclose(fp);
+  }
+  remove(paths[FILES - 1]);
+  // On the heap, in an arena, and in an arena with the keys interned.
+  for (int mode = 0; mode < 3; ++mode)
+  {
+    TOMLArena arena;
+    TOMLArena_init(&arena, 0);
+    TOMLInterner keys;
+    TOMLInterner_init(&keys);
+    TOMLKey const *port = TOMLInterner_intern(&keys, "port", 4);
+    TOMLFileResult results[FILES];
+    TOMLStatus status = TOML_parse_many(path_ps, FILES,
+                                        mode > 0 ? &arena : NULL,
+                                        TOML_F_ZERO_COPY,
+                                        mode == 2 ? &keys : NULL, results, 4);
+    CU_ASSERT_EQUAL_FATAL(status, results[7].status);
+    for (int i = 0; i < FILES; ++i)
+    {
+      if (i == 7)
+      {
+        CU_ASSERT_NOT_EQUAL_FATAL(results[i].status, TOML_E_OK);
+        CU_ASSERT_PTR_NULL_FATAL(results[i].table);
+        CU_ASSERT_EQUAL_FATAL(results[i].position.line, 2);
+      } else if (i == FILES - 1)
+      {
+        CU_ASSERT_EQUAL_FATAL(results[i].status, TOML_E_IO);
+        CU_ASSERT_PTR_NULL_FATAL(results[i].table);
+      } else
+      {
+        CU_ASSERT_EQUAL_FATAL(results[i].status, TOML_E_OK);
+        TOMLTable table = results[i].table;
+        // The files were unmapped, so the strings had to be copied.
+        CU_ASSERT_EQUAL_FATAL(TBLGET(table, "name")->kind, TOML_STRING);
+        TOMLTable limits = TBLGET(table, "limits")->table;
+        CU_ASSERT_EQUAL_FATAL(TBLGET(limits, "port")->integer, 8000 + i);
+        CU_ASSERT_EQUAL_FATAL(limits[0].key == port->data, mode == 2);
+        // The tables outlive the threads that built them.
+        put_extras(&table);
+        CU_ASSERT_EQUAL_FATAL(TOMLTable_freeze(&table), 0);
+        CU_ASSERT_EQUAL_FATAL(TBLGET(table, "extra0")->integer, 0);
+        CU_ASSERT_EQUAL_FATAL(TBLGET(table, "extra15")->integer, 15);
+        TOMLTable_destroy(table);
+      }
+    }
+    TOMLArena_destroy(&arena);
+    TOMLInterner_destroy(&keys);
+  }
+  for (int i = 0; i < FILES - 1; ++i)
+  {
+    remove(paths[i]);
+  }
+}
+
+typedef struct SnapshotReader {
+  TOMLSnapshot *snap;
+  int           found;
+} SnapshotReader;
+
+static void *read_snapshot(void *arg)
+{
+  SnapshotReader *reader = arg;
+  TOMLTable root = TOMLSnapshot_root(reader->snap);
+  for (int i = 0; i < 1000; ++i)
+  {
+    TOMLTable limits = TBLGET(root, "limits")->table;
+    reader->found += TBLGET(limits, "port")->integer == 8080;
+  }
+  TOMLSnapshot_release(reader->snap);
+  return NULL;
+}
+
+void test_snapshot(void)
+{
+  char const *path = "lib_test.toml";
+  FILE *fp = fopen(path, "wb");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(fp);
+  fprintf(fp, "name = 'snapshot'\n[limits]\nport = 8080\n");
+  fclose(fp);
+  TOMLCtx ctx;
+  TOMLSnapshot *snap;
+  TOMLInterner keys;
+  TOMLInterner_init(&keys);
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLSnapshot_parse_file(&snap, &ctx, path, TOML_F_ZERO_COPY, &keys),
+      TOML_E_OK
+  );
+  CU_ASSERT_PTR_NULL_FATAL(ctx.content);
+  // Freezing copied the keys out of the interner.
+  CU_ASSERT_EQUAL_FATAL(keys.count, 3);
+  TOMLInterner_destroy(&keys);
+  TOMLTable root = TOMLSnapshot_root(snap);
+  CU_ASSERT_TRUE_FATAL(TOMLTable_frozen(root));
+  // The strings were copied, so rewriting the file doesn't touch them.
+  CU_ASSERT_EQUAL_FATAL(TBLGET(root, "name")->kind, TOML_STRING);
+  fp = fopen(path, "wb");
+  fprintf(fp, "name = 'changed!'\n");
+  fclose(fp);
+  CU_ASSERT_STRING_EQUAL_FATAL(TBLGET(root, "name")->string, "snapshot");
+  TOMLStringView const extra = { "extra", 5 };
+  CU_ASSERT_PTR_NULL_FATAL(TOMLTable_put_view(&root, extra));
+
+  pthread_t threads[4];
+  SnapshotReader readers[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    readers[i] = (SnapshotReader) { TOMLSnapshot_retain(snap), 0 };
+    CU_ASSERT_EQUAL_FATAL(
+        pthread_create(&threads[i], NULL, read_snapshot, &readers[i]), 0
+    );
+  }
+  // The threads may outlive the reference this one holds.
+  TOMLSnapshot_release(snap);
+  for (int i = 0; i < 4; ++i)
+  {
+    pthread_join(threads[i], NULL);
+    CU_ASSERT_EQUAL_FATAL(readers[i].found, 1000);
+  }
+
+  fp = fopen(path, "wb");
+  fprintf(fp, "name = 'snapshot'\nname = 'again'\n");
+  fclose(fp);
+  CU_ASSERT_EQUAL_FATAL(TOMLSnapshot_parse_file(&snap, &ctx, path, 0, NULL),
+                        TOML_E_DUPLICATE_KEY);
+  CU_ASSERT_EQUAL_FATAL(TOML_position(&ctx).line, 2);
+  TOML_unmap(&ctx);
+  remove(path);
+
+  TOMLTable table = TOMLTable_new();
+  TOMLValue *val_p = TOMLTable_put_view(&table, extra);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(val_p);
+  *val_p = (TOMLValue) { .integer = 1, .kind = TOML_INTEGER };
+  CU_ASSERT_EQUAL_FATAL(TOMLSnapshot_new(&snap, &table, NULL), TOML_E_OK);
+  CU_ASSERT_PTR_NULL_FATAL(table);
+  CU_ASSERT_EQUAL_FATAL(TBLGET(TOMLSnapshot_root(snap), "extra")->integer, 1);
+  TOMLSnapshot_release(snap);
+}
+
+typedef struct ReloadReader {
+  TOMLReload *reload;
+  int         stop;
+  int         reads;
+  int         ordered;
+} ReloadReader;
+
+static void *read_reload(void *arg)
+{
+  ReloadReader *state = arg;
+  TOMLReload_Reader reader;
+  TOMLReload_register(state->reload, &reader);
+  long last = 0;
+  while (!__atomic_load_n(&state->stop, __ATOMIC_ACQUIRE))
+  {
+    TOMLSnapshot *snap = TOMLReload_enter(state->reload, &reader);
+    TOMLTable limits = TBLGET(TOMLSnapshot_root(snap), "limits")->table;
+    long const version = TBLGET(limits, "version")->integer;
+    state->ordered &= version >= last;
+    last = version;
+    ++state->reads;
+    TOMLReload_leave(&reader);
+  }
+  TOMLReload_unregister(state->reload, &reader);
+  return NULL;
+}
+
+static TOMLSnapshot *make_snapshot(int version)
+{
+  char data[64];
+  sprintf(data, "[limits]\nversion = %d\n", version);
+  TOMLCtx ctx = make_toml(data, 0);
+  TOMLTable table = TOMLTable_new();
+  TOMLSnapshot *snap = NULL;
+  if (TOML_parse(&ctx, &table) != TOML_E_OK ||
+      TOMLSnapshot_new(&snap, &table, NULL) != TOML_E_OK)
+  {
+    TOMLTable_destroy(table);
+  }
+  return snap;
+}
+
+void test_reload(void)
+{
+  TOMLReload reload;
+  TOMLReload_init(&reload, make_snapshot(0));
+  pthread_t threads[4];
+  ReloadReader readers[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    readers[i] = (ReloadReader) { &reload, 0, 0, 1 };
+    CU_ASSERT_EQUAL_FATAL(
+        pthread_create(&threads[i], NULL, read_reload, &readers[i]), 0
+    );
+  }
+  for (int version = 1; version <= 200; ++version)
+  {
+    TOMLSnapshot *snap = make_snapshot(version);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(snap);
+    TOMLReload_publish(&reload, snap);
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    __atomic_store_n(&readers[i].stop, 1, __ATOMIC_RELEASE);
+    pthread_join(threads[i], NULL);
+    CU_ASSERT_TRUE_FATAL(readers[i].ordered);
+  }
+  // With nobody reading, every retired snapshot can go.
+  CU_ASSERT_EQUAL_FATAL(TOMLReload_collect(&reload), 0);
+
+  TOMLReload_Reader reader;
+  TOMLReload_register(&reload, &reader);
+  TOMLSnapshot *old = TOMLReload_enter(&reload, &reader);
+  TOMLReload_publish(&reload, make_snapshot(201));
+  // The old snapshot waits for the reader that may still see it.
+  CU_ASSERT_EQUAL_FATAL(TOMLReload_collect(&reload), 1);
+  TOMLTable limits = TBLGET(TOMLSnapshot_root(old), "limits")->table;
+  CU_ASSERT_EQUAL_FATAL(TBLGET(limits, "version")->integer, 200);
+  TOMLReload_leave(&reader);
+  CU_ASSERT_EQUAL_FATAL(TOMLReload_collect(&reload), 0);
+  TOMLReload_unregister(&reload, &reader);
+  TOMLReload_destroy(&reload);
+}
+
+typedef struct WatchLog {
+  int          events;
+  int          last_index;
+  long         previous;  ///< The version in the previous snapshot, or -1.
+  long         current;   ///< The version in the new snapshot, or -1.
+  TOMLStatus   status;
+} WatchLog;
+
+static long snapshot_version(TOMLSnapshot const *snap)
+{
+  return snap == NULL ? -1 :
+         TBLGET(TOMLSnapshot_root(snap), "version")->integer;
+}
+
+static void log_watch(void *data, TOMLWatch_Event const *event)
+{
+  WatchLog *log = data;
+  ++log->events;
+  log->last_index = event->index;
+  log->previous = snapshot_version(event->previous);
+  log->current = snapshot_version(event->current);
+  log->status = event->status;
+}
+
+static void write_file(char const *path, char const *data)
+{
+  FILE *fp = fopen(path, "wb");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(fp);
+  fputs(data, fp);
+  fclose(fp);
+}
+
+static void *keep_writing(void *arg)
+{
+  int *stop = arg;
+  for (int i = 0; !__atomic_load_n(stop, __ATOMIC_ACQUIRE); ++i)
+  {
+    char data[32];
+    sprintf(data, "version = %d\n", 20 + i);
+    write_file("./lib_test_b.toml", data);
+    usleep(5000);
+  }
+  return NULL;
+}
+
+void test_watch(void)
+{
+  char const *paths[] = { "lib_test_a.toml", "./lib_test_b.toml" };
+  write_file(paths[0], "version = 1\n");
+  write_file(paths[1], "version = 10\n");
+  WatchLog log = { 0 };
+  TOMLWatch watch;
+  TOMLInterner keys;
+  TOMLInterner_init(&keys);
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLWatch_init(&watch, paths, 2, 0, &keys, log_watch, &log), TOML_E_OK
+  );
+  watch.debounce = 20;
+  CU_ASSERT_EQUAL_FATAL(log.events, 2);
+  CU_ASSERT_EQUAL_FATAL(snapshot_version(TOMLWatch_get(&watch, 1)), 10);
+  CU_ASSERT_EQUAL_FATAL(keys.count, 1);
+
+  // Nothing changed.
+  CU_ASSERT_EQUAL_FATAL(TOMLWatch_poll(&watch, 0), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(log.events, 2);
+
+  // A burst of writes to one file, and one to a file that isn't watched.
+  write_file(paths[1], "version = 11\n");
+  write_file(paths[1], "version = 12\n");
+  write_file("lib_test_c.toml", "version = 100\n");
+  CU_ASSERT_EQUAL_FATAL(TOMLWatch_poll(&watch, 1000), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(log.events, 3);
+  CU_ASSERT_EQUAL_FATAL(log.last_index, 1);
+  CU_ASSERT_EQUAL_FATAL(log.previous, 10);
+  CU_ASSERT_EQUAL_FATAL(log.current, 12);
+
+  // Replaced by renaming another file over it, with an error.
+  write_file("lib_test_c.toml", "version = = 2\n");
+  CU_ASSERT_EQUAL_FATAL(rename("lib_test_c.toml", paths[0]), 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLWatch_poll(&watch, 1000), TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(log.events, 4);
+  CU_ASSERT_EQUAL_FATAL(log.last_index, 0);
+  CU_ASSERT_NOT_EQUAL_FATAL(log.status, TOML_E_OK);
+  CU_ASSERT_EQUAL_FATAL(log.current, -1);
+  // The last snapshot that parsed stays.
+  CU_ASSERT_EQUAL_FATAL(snapshot_version(TOMLWatch_get(&watch, 0)), 1);
+
+  // A file that never stops changing is still parsed once the burst has
+  // been waited out for long enough.
+  watch.settle = 200;
+  pthread_t writer;
+  int stop = 0;
+  CU_ASSERT_EQUAL_FATAL(
+      pthread_create(&writer, NULL, keep_writing, &stop), 0
+  );
+  CU_ASSERT_EQUAL_FATAL(TOMLWatch_poll(&watch, 1000), TOML_E_OK);
+  int const events = log.events;
+  __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+  pthread_join(writer, NULL);
+  CU_ASSERT_TRUE_FATAL(events > 4);
+  TOMLWatch_destroy(&watch);
+  TOMLInterner_destroy(&keys);
+  remove(paths[0]);
+  remove(paths[1]);
+
+  // The directory of a file goes away.
+  char const *nested[] = { "lib_test_dir/lib_test.toml" };
+  CU_ASSERT_EQUAL_FATAL(mkdir("lib_test_dir", 0755), 0);
+  write_file(nested[0], "version = 1\n");
+  CU_ASSERT_EQUAL_FATAL(
+      TOMLWatch_init(&watch, nested, 1, 0, NULL, log_watch, &log), TOML_E_OK
+  );
+  watch.debounce = 20;
+  remove(nested[0]);
+  CU_ASSERT_EQUAL_FATAL(rmdir("lib_test_dir"), 0);
+  CU_ASSERT_EQUAL_FATAL(TOMLWatch_poll(&watch, 1000), TOML_E_IO);
+  TOMLWatch_destroy(&watch);
+}
+
 int main(int argc, char **argv)
 {
   int status = 0;
@@ -1149,6 +2730,24 @@ int main(int argc, char **argv)
     { "#parse_table_header", test_parse_table_header },
     { "#parse_table",        test_parse_table        },
     { "#parse",              test_parse              },
+    { "#arena",              test_arena              },
+    { "#zero_copy",          test_zero_copy          },
+    { "#parse_file",         test_parse_file         },
+    { "#stream",             test_stream             },
+    { "#events",             test_events             },
+    { "#tape",               test_tape               },
+    { "#doc",                test_doc                },
+    { "#table",              test_table              },
+    { "#freeze",             test_freeze             },
+    { "#intern",             test_intern             },
+    { "#get_key",            test_get_key            },
+    { "#pack_arrays",        test_pack_arrays        },
+    { "#short_strings",      test_short_strings      },
+    { "#parse_parallel",     test_parse_parallel     },
+    { "#parse_many",         test_parse_many         },
+    { "#snapshot",           test_snapshot           },
+    { "#reload",             test_reload             },
+    { "#watch",              test_watch              },
     CU_TEST_INFO_NULL
   };
   CU_SuiteInfo suites[] = {
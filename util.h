@@ -10,22 +10,6 @@
 
 typedef _Bool bool;
 
-/* __inline__
-StringBuffer read_file(char *path, int *size_p)
-{
-  FILE *fp = fopen(path, "r");
-  if (fp == NULL)
-    return NULL;
-  fseek(fp, 0, SEEK_END);
-  int size = ftell(fp);
-  fseek(fp, 0, SEEK_SET);
-  StringBuffer text = StringBuffer_with_length(size + 1);
-  fread(text, size, 1, fp);
-  text[size] = '\0';
-  fclose(fp);
-  *size_p = size;
-  return text;
-} */
 #define in_range(c, x, y) (((c) >= (x)) && ((c) <= (y)))
 
 #define is_letter(c)                              \
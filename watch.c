@@ -0,0 +1,273 @@
+/*
+ * @file watch.c
+ * @brief Parsing configuration files again when they change.
+ */
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include "lib.h"
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | \
+                      IN_DELETE_SELF | IN_MOVE_SELF)
+// The events that mean a watched directory is gone from its path.
+#define WATCH_LOST (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)
+
+/*
+ * @brief The milliseconds of a monotonic clock.
+ */
+static long now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &(ts));
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * @brief Parses the `i`th file into a new snapshot and reports it.
+ */
+static void reparse(TOMLWatch *watch, int i)
+{
+  TOMLWatch_File *const file = &(watch->files[i]);
+  TOMLCtx ctx = { .mapped = 0 };
+  TOMLWatch_Event event = {
+    .index = i,
+    .path = file->path,
+    .previous = file->snap
+  };
+  event.status = TOMLSnapshot_parse_file(&(event.current), &(ctx),
+                                         file->path, watch->flags,
+                                         watch->keys);
+  if (event.status != TOML_E_OK)
+  {
+    event.current = NULL;
+    // Whether the file got as far as being parsed.
+    if (ctx.mapped != 0)
+    {
+      event.position = TOML_position(&(ctx));
+    }
+    TOML_unmap(&(ctx));
+  }
+  file->dirty = 0;
+  if (watch->callback != NULL)
+  {
+    watch->callback(watch->data, &(event));
+  }
+  if (event.current != NULL)
+  {
+    file->snap = event.current;
+    TOMLSnapshot_release(event.previous);
+  }
+}
+
+/*
+ * @brief Reads the pending events of the inotify instance and marks the
+ *        files they are about as dirty.
+ * @returns `-1` if reading failed.
+ */
+static int read_events(TOMLWatch *watch)
+{
+  char buffer[4096]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t const len = read(watch->fd, buffer, sizeof(buffer));
+  if (len < 0)
+  {
+    return errno == EAGAIN || errno == EINTR ? 0 : -1;
+  }
+  for (char *p = buffer; p < buffer + len; )
+  {
+    struct inotify_event const *event = (struct inotify_event *)p;
+    if (event->mask & IN_MOVE_SELF)
+    {
+      // The directory lives on somewhere else, but not at its path.
+      inotify_rm_watch(watch->fd, event->wd);
+    }
+    for (int i = 0; i < watch->count; ++(i))
+    {
+      TOMLWatch_File *const file = &(watch->files[i]);
+      if (event->wd == file->wd && (event->mask & WATCH_LOST))
+      {
+        file->wd = -1;
+      } else if ((event->mask & IN_Q_OVERFLOW) ||
+                 (event->wd == file->wd && event->len > 0 &&
+                  strcmp(event->name, file->name) == 0))
+      {
+        // Events were lost, so anything could have changed.
+        file->dirty = 1;
+      }
+    }
+    p += sizeof(struct inotify_event) + event->len;
+  }
+  return 0;
+}
+
+/*
+ * @brief Watches the directories of the files that went away again, the
+ *        files in them may have changed in the meantime.
+ * @returns `-1` if a directory can't be watched.
+ */
+static int rewatch(TOMLWatch *watch)
+{
+  for (int i = 0; i < watch->count; ++(i))
+  {
+    TOMLWatch_File *const file = &(watch->files[i]);
+    if (file->wd < 0)
+    {
+      char const *const dir = file->path + strlen(file->path) + 1;
+      file->wd = inotify_add_watch(watch->fd, dir, WATCH_EVENTS);
+      if (file->wd < 0)
+      {
+        return -1;
+      }
+      file->dirty = 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Starts watching the `n` files at `paths` and parses each of them,
+ *        reporting it to `callback`.
+ * @param flags The `TOML_F_*` flags to parse with.
+ * @param keys The interner to put the keys through, or `NULL`. It only has
+ *             to outlive the watcher, since snapshots copy their keys.
+ * @param callback What to call with the event of every file that is parsed,
+ *                 or `NULL`.
+ * @returns @link TOML_E_IO @endlink if the directories of the files can't be
+ *          watched, `errno` tells why, @link TOML_E_OOM @endlink if the
+ *          system is out of memory. Files that don't parse aren't an error,
+ *          they are reported and parsed again once they change.
+ */
+TOMLStatus TOMLWatch_init(TOMLWatch *watch, char const *const *paths, int n,
+                          int flags, TOMLInterner *keys,
+                          TOMLWatch_Callback callback, void *data)
+{
+  TOMLStatus status = TOML_E_OK;
+  watch->flags = flags;
+  watch->keys = keys;
+  watch->debounce = TOML_WATCH_DEBOUNCE;
+  watch->settle = TOML_WATCH_SETTLE;
+  watch->count = 0;
+  watch->callback = callback;
+  watch->data = data;
+  watch->files = calloc(n, sizeof(TOMLWatch_File));
+  watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watch->files == NULL || watch->fd < 0)
+  {
+    status = watch->files == NULL ? TOML_E_OOM : TOML_E_IO;
+    TOMLWatch_destroy(watch);
+    return status;
+  }
+  for (int i = 0; i < n; ++(i))
+  {
+    TOMLWatch_File *const file = &(watch->files[i]);
+    // The path is kept as the directory, a null byte and the name, after
+    // the path itself.
+    size_t const len = strlen(paths[i]);
+    char const *slash = strrchr(paths[i], '/');
+    file->path = malloc(2 * len + 4);
+    if (file->path == NULL)
+    {
+      status = TOML_E_OOM;
+      break;
+    }
+    ++(watch->count);
+    memcpy(file->path, paths[i], len + 1);
+    char *const dir = file->path + len + 1;
+    if (slash == NULL)
+    {
+      strcpy(dir, ".");
+      file->name = strcpy(dir + 2, paths[i]);
+    } else
+    {
+      size_t const dir_len = slash == paths[i] ? 1 : slash - paths[i];
+      memcpy(dir, paths[i], dir_len);
+      dir[dir_len] = '\0';
+      file->name = strcpy(dir + dir_len + 1, slash + 1);
+    }
+    file->wd = inotify_add_watch(watch->fd, dir, WATCH_EVENTS);
+    if (file->wd < 0)
+    {
+      status = TOML_E_IO;
+      break;
+    }
+  }
+  if (status != TOML_E_OK)
+  {
+    TOMLWatch_destroy(watch);
+    return status;
+  }
+  for (int i = 0; i < n; ++(i))
+  {
+    reparse(watch, i);
+  }
+  return status;
+}
+
+/**
+ * @brief Waits up to `timeout` milliseconds for the watched files to change,
+ *        and parses the ones that did once the changes settle.
+ * @param timeout How long to wait, `-1` to wait for a change and `0` to
+ *                only handle the changes that are pending.
+ * @returns @link TOML_E_IO @endlink if the changes can't be read or the
+ *          directory of a file is gone, `errno` tells why. Parsing errors
+ *          are reported to the callback.
+ */
+TOMLStatus TOMLWatch_poll(TOMLWatch *watch, int timeout)
+{
+  struct pollfd pfd = { .fd = watch->fd, .events = POLLIN };
+  int ready = poll(&(pfd), 1, timeout);
+  if (ready < 0)
+  {
+    return errno == EINTR ? TOML_E_OK : TOML_E_IO;
+  }
+  long const deadline = now() + watch->settle;
+  while (ready > 0)
+  {
+    if (read_events(watch) != 0)
+    {
+      return TOML_E_IO;
+    }
+    // What's left after the deadline is read by the next call.
+    long const left = deadline - now();
+    ready = left <= 0 ? 0 :
+            poll(&(pfd), 1, left < watch->debounce ? left : watch->debounce);
+  }
+  if (rewatch(watch) != 0)
+  {
+    return TOML_E_IO;
+  }
+  for (int i = 0; i < watch->count; ++(i))
+  {
+    if (watch->files[i].dirty)
+    {
+      reparse(watch, i);
+    }
+  }
+  return TOML_E_OK;
+}
+
+/**
+ * @brief Stops watching and releases the snapshots of the files.
+ */
+void TOMLWatch_destroy(TOMLWatch *watch)
+{
+  if (watch->fd >= 0)
+  {
+    close(watch->fd);
+    watch->fd = -1;
+  }
+  for (int i = 0; i < watch->count; ++(i))
+  {
+    TOMLSnapshot_release(watch->files[i].snap);
+    free(watch->files[i].path);
+  }
+  free(watch->files);
+  watch->files = NULL;
+  watch->count = 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * @file watch.h
+ * @brief Parsing configuration files again when they change.
+ */
+
+#ifndef C_TOML_WATCH_H
+#define C_TOML_WATCH_H
+#ifndef C_TOML_H
+#include "lib.h"
+#endif
+
+#define TOML_WATCH_DEBOUNCE 50 ///< How many milliseconds a burst of changes
+                               ///< has to be quiet for by default.
+#define TOML_WATCH_SETTLE 1000 ///< How many milliseconds a burst of changes
+                               ///< is waited out for at most by default.
+
+typedef struct TOMLWatch       TOMLWatch;
+typedef struct TOMLWatch_File  TOMLWatch_File;
+typedef struct TOMLWatch_Event TOMLWatch_Event;
+
+/**
+ * @struct TOMLWatch_Event
+ * @brief What a watched file was parsed into, after it was loaded or
+ *        changed.
+ */
+struct TOMLWatch_Event {
+  int           index;    ///< Which of the watched files it is.
+  char const   *path;
+  TOMLSnapshot *previous; ///< The last snapshot of the file that parsed,
+                          ///< `NULL` if there's none.
+  TOMLSnapshot *current;  ///< The new snapshot, `NULL` if the file couldn't
+                          ///< be parsed.
+  TOMLStatus    status;
+  TOMLPosition  position; ///< Where the error is, if it's a parsing error.
+};
+
+/**
+ * @typedef TOMLWatch_Callback
+ * @brief Called with the event of every file that was parsed. The snapshots
+ *        are only borrowed for the call, the callback takes a reference to
+ *        keep them.
+ */
+typedef void (*TOMLWatch_Callback)(void *, TOMLWatch_Event const *);
+
+/**
+ * @struct TOMLWatch_File
+ * @brief A watched file.
+ */
+struct TOMLWatch_File {
+  char         *path;
+  char const   *name;  ///< The name of the file inside its directory.
+  int           wd;    ///< The watch of its directory, `-1` if the
+                       ///< directory went away.
+  int           dirty; ///< Whether it changed since it was last parsed.
+  TOMLSnapshot *snap;  ///< The last snapshot of it that parsed.
+};
+
+/**
+ * @struct TOMLWatch
+ * @brief A set of files that are parsed again when they change.
+ *
+ * The directories of the files are watched with inotify, so files that are
+ * replaced by renaming another one over them, like editors do, are noticed
+ * too. Changes come in bursts, so once one is noticed the watcher waits
+ * for `debounce` milliseconds without changes before parsing anything, but
+ * no longer than `settle` milliseconds in all, so that a file that keeps
+ * changing still gets parsed. Then it only parses the files that changed.
+ *
+ * A file that doesn't parse keeps its last snapshot. If the directory of a
+ * file is removed or renamed, the watcher watches whatever directory is at
+ * its path again, and fails if there's none.
+ */
+struct TOMLWatch {
+  int                 fd;       ///< The inotify instance, which can be
+                                ///< polled by an event loop.
+  int                 flags;    ///< The `TOML_F_*` flags to parse with.
+  TOMLInterner       *keys;     ///< The interner to put the keys through,
+                                ///< or `NULL`. Only the thread that polls
+                                ///< uses it.
+  int                 debounce;
+  int                 settle;
+  TOMLWatch_File     *files;
+  int                 count;
+  TOMLWatch_Callback  callback;
+  void               *data;
+};
+
+TOMLStatus TOMLWatch_init   (TOMLWatch *, char const *const *, int, int,
+                             TOMLInterner *, TOMLWatch_Callback, void *);
+TOMLStatus TOMLWatch_poll   (TOMLWatch *, int);
+void       TOMLWatch_destroy(TOMLWatch *);
+/// The last snapshot of the `i`th file of `w` that parsed.
+#define TOMLWatch_get(w, i) ((w)->files[i].snap)
+
+#endif /* C_TOML_WATCH_H */